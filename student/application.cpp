@@ -50,9 +50,20 @@ void Application::setMethod(uint32_t m){
   selectedMethod = m;
 }
 
+/**
+ * @brief This function sets number of rasterization threads of rendering methods
+ *
+ * @param n number of threads
+ */
+void Application::setNofThreads(uint32_t n){
+  nofThreads = n;
+  if(method)method->gpu.setNofThreads(nofThreads);
+}
+
 void Application::createMethodIfItDoesNotExist(){
   if(method)return;
   method = methodFactories[selectedMethod]();
+  method->gpu.setNofThreads(nofThreads);
   int w,h;
   SDL_GetWindowSize(getWindow(),&w,&h);
   method->gpu.createFramebuffer(w,h);
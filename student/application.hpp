@@ -29,6 +29,7 @@ class Application: protected Window{
     void registerMethod(std::string const&name);
     void start();
     void setMethod(uint32_t m);
+    void setNofThreads(uint32_t n);
   private:
     void idle();
     void resize(SDL_Event const&event);
@@ -53,6 +54,7 @@ class Application: protected Window{
     std::vector<std::string>       methodName                                   ;
     size_t                         selectedMethod    = 0                        ;
     std::shared_ptr<Method>        method                                       ;
+    uint32_t                       nofThreads        = 1                        ;
 
     glm::uvec2                     windowSize                                   ;
     float                          sensitivity       = 0.01f                    ;
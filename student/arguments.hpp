@@ -31,6 +31,7 @@ class Arguments{
       method              = args->getu32   ("-m",0,"selects a rendering method");
       groundTruthFile     = args->gets     ("-g","../tests/output.bmp","specify groundTruth image");
       perfTests           = args->getu32   ("-f",10,"number of frames that are tests during performance tests");
+      nofThreads          = args->getu32   ("--threads",1,"number of rasterization threads");
 
       auto printHelp  = args->isPresent("-h"    ,"prints help");
       printHelp |= args->isPresent("--help","prints help");
@@ -50,5 +51,6 @@ class Arguments{
   bool takeScreenShot;///< should we take a screnshot
   bool stop = false; ///< should we immediately stop
   uint32_t perfTests; ///< number of frames in performance tests
+  uint32_t nofThreads = 1; ///< number of rasterization threads
 };
 
@@ -15,6 +15,10 @@
 uint32_t const maxAttributes = 16;///< maximum number of vertex/fragment attributes
 uint32_t const maxUniforms   = 16;///< maximum number of uniform variables
 uint32_t const emptyID       = 0xffffffff;///< empty object id (for buffers, programs and vertex pullers)
+uint32_t const stampWidth    = 4;///< width of rasterization stamp (two 2x2 pixel quads)
+uint32_t const stampHeight   = 2;///< height of rasterization stamp
+uint32_t const stampSize     = stampWidth*stampHeight;///< number of pixels in rasterization stamp
+uint32_t const rasterBlockSize = 8;///< width and height of coarse rasterization block in pixels (power of two, multiple of stamp size)
 
 /**
  * @brief This enum represents vertex/fragment attribute type.
@@ -54,6 +58,33 @@ struct OutVertex{
   glm::vec4 gl_Position              ; ///< clip space position
 };
 
+uint32_t const vertexShaderBatchSize = 8;///< number of vertices in batch of vertex shader
+
+/**
+ * @brief This struct represents batch of input vertices in structure of arrays layout.
+ * Attributes that are not read by vertex puller contain ones, like attributes of InVertex.
+ */
+struct InVertexBatch{
+  InVertexBatch(){
+    for(auto&attribute:attributes)
+      for(auto&component:attribute)
+        for(auto&lane:component)
+          lane = 1.f;
+  }
+  float    attributes[maxAttributes][4][vertexShaderBatchSize]; ///< vertex attributes, indexed by attribute, component and lane
+  uint32_t gl_VertexID[vertexShaderBatchSize]                 ; ///< vertex ids
+  uint32_t count                                              ; ///< number of vertices, lanes from count onward are not used
+};
+
+/**
+ * @brief This struct represents batch of output vertices in structure of arrays layout.
+ * Values of lanes that are not written by vertex shader are undefined.
+ */
+struct OutVertexBatch{
+  float attributes[maxAttributes][4][vertexShaderBatchSize]; ///< vertex attributes, indexed by attribute, component and lane
+  float gl_Position[4][vertexShaderBatchSize]              ; ///< clip space positions, indexed by component and lane
+};
+
 /**
  * @brief This struct represents input fragment.
  */
@@ -69,6 +100,27 @@ struct OutFragment{
   glm::vec4 gl_FragColor; ///< fragment color
 };
 
+uint32_t const fragmentBatchSize = stampSize;///< number of fragments in batch of fragment shader (one rasterization stamp)
+
+/**
+ * @brief This struct represents batch of input fragments in structure of arrays layout.
+ * Lanes are ordered by 2x2 quads, lanes 4q+0, 4q+1, 4q+2, 4q+3 are bottom-left, bottom-right, top-left and top-right pixel of quad q,
+ * so derivatives can be computed as differences of neighbouring lanes.
+ * Attributes are interpolated in all lanes, lanes that are not in the mask are only helpers for derivatives.
+ */
+struct InFragmentBatch{
+  float    attributes[maxAttributes][4][fragmentBatchSize]; ///< fragment attributes, indexed by attribute, component and lane
+  float    gl_FragCoord[4][fragmentBatchSize]             ; ///< fragment coordinates, indexed by component and lane
+  uint32_t mask                                           ; ///< coverage mask, bit i is set if lane i is a fragment that has to be shaded
+};
+
+/**
+ * @brief This struct represents batch of output fragments in structure of arrays layout.
+ */
+struct OutFragmentBatch{
+  float gl_FragColor[4][fragmentBatchSize]; ///< fragment colors, indexed by component and lane
+};
+
 /**
  * @brief This union represents one uniform variable.
  */
@@ -97,6 +149,41 @@ enum class IndexType{
   UINT32 = 4, ///< uint32_t type
 };
 
+/**
+ * @brief This enum represents which triangles are culled according to their facing
+ */
+enum class CullMode{
+  NONE  = 0, ///< no triangles are culled
+  BACK  = 1, ///< back-facing triangles are culled
+  FRONT = 2, ///< front-facing triangles are culled
+};
+
+/**
+ * @brief This enum represents winding of front-facing triangles in screen space
+ */
+enum class FrontFace{
+  CCW = 0, ///< counter clock wise triangles are front-facing
+  CW  = 1, ///< clock wise triangles are front-facing
+};
+
+/**
+ * @brief This enum represents interpolation of vertex attribute into fragment attribute
+ */
+enum class Interpolation{
+  SMOOTH        = 0, ///< perspective correct interpolation
+  NOPERSPECTIVE = 1, ///< linear interpolation in screen space
+  FLAT          = 2, ///< value of provoking vertex (the first vertex of triangle), no interpolation
+};
+
+/**
+ * @brief This enum represents format of depth buffer
+ */
+enum class DepthFormat{
+  D32F = 0, ///< 32-bit float depth
+  D24  = 1, ///< 24-bit unsigned normalized depth, stored in 32 bits
+  D16  = 2, ///< 16-bit unsigned normalized depth
+};
+
 /**
  * @brief Function type for vertex shader
  *
@@ -109,6 +196,18 @@ using VertexShader   = void(*)(
     InVertex  const&inVertex ,
     Uniforms  const&uniforms );
 
+/**
+ * @brief Function type for batched vertex shader, it transforms all vertices of a batch in one call
+ *
+ * @param outVertices output vertices
+ * @param inVertices input vertices
+ * @param uniforms uniform variables
+ */
+using VertexShaderBatch = void(*)(
+    OutVertexBatch      &outVertices,
+    InVertexBatch  const&inVertices ,
+    Uniforms       const&uniforms   );
+
 /**
  * @brief Function type for fragment shader
  *
@@ -121,8 +220,21 @@ using FragmentShader = void(*)(
     InFragment  const&inFragment ,
     Uniforms    const&uniforms   );
 
+/**
+ * @brief Function type for batched fragment shader, it shades all fragments of a batch in one call
+ *
+ * @param outFragments output fragments
+ * @param inFragments input fragments
+ * @param uniforms uniform variables
+ */
+using FragmentShaderBatch = void(*)(
+    OutFragmentBatch      &outFragments,
+    InFragmentBatch  const&inFragments ,
+    Uniforms         const&uniforms    );
+
 using ObjectID       = uint64_t;///< object id (program, buffer, vertex puller)
 using BufferID       = ObjectID;///< buffer id
 using VertexPullerID = ObjectID;///< vertex puller id
 using ProgramID      = ObjectID;///< shader program id
+using PipelineID     = ObjectID;///< pipeline state object id
 
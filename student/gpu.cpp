@@ -6,10 +6,172 @@
  */
 
 #include <student/gpu.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+//coverage of a stamp is tested with SIMD unless GPU_SCALAR_RASTERIZER is defined
+#if !defined(GPU_SCALAR_RASTERIZER) && defined(__AVX2__)
+#define GPU_COVERAGE_AVX2
+#include <immintrin.h>
+#elif !defined(GPU_SCALAR_RASTERIZER) && (defined(__SSE2__) || defined(_M_X64))
+#define GPU_COVERAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+//fragment colors are converted to RGBA8 with SIMD whenever coverage test uses SIMD
+#if defined(GPU_COVERAGE_AVX2) || defined(GPU_COVERAGE_SSE2)
+#define GPU_COLOR_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 
+/**
+ * @brief This class represents pool of worker threads that execute independent jobs.
+ */
+class ThreadPool{
+  public:
+    explicit ThreadPool(uint32_t nofWorkers);
+    ~ThreadPool();
+    void parallelFor(uint32_t nofJobs, function<void(uint32_t job, uint32_t worker)> const&task);
+    uint32_t getNofWorkers() const;
+  private:
+    void workerLoop(uint32_t worker);
+    void runJobs(uint32_t worker);
+
+    vector<thread> threads;
+    mutex jobMutex;
+    condition_variable jobsReady;
+    condition_variable jobsDone;
+    function<void(uint32_t, uint32_t)> const* currentTask = nullptr;
+    uint32_t nofJobs = 0;
+    atomic<uint32_t> nextJob{0};
+    uint32_t busyWorkers = 0;
+    uint64_t generation = 0;
+    bool quit = false;
+};
+
+/**
+ * @brief Constructor of thread pool
+ *
+ * @param nofWorkers number of workers including the thread that calls parallelFor
+ */
+ThreadPool::ThreadPool(uint32_t nofWorkers){
+  for (uint32_t worker = 1; worker < nofWorkers; ++worker)
+    threads.emplace_back([this, worker](){workerLoop(worker);});
+}
+
+/**
+ * @brief Destructor of thread pool
+ */
+ThreadPool::~ThreadPool(){
+  {
+    lock_guard<mutex> lock(jobMutex);
+    quit = true;
+  }
+  jobsReady.notify_all();
+  for (auto &t : threads)
+    t.join();
+}
+
+/**
+ * @brief This function returns number of workers including the calling thread.
+ *
+ * @return number of workers
+ */
+uint32_t ThreadPool::getNofWorkers() const{
+  return static_cast<uint32_t>(threads.size()) + 1;
+}
+
+/**
+ * @brief This function executes jobs 0..nofJobs-1 in parallel and waits for them.
+ * The calling thread works as worker 0.
+ *
+ * @param nofJobs number of jobs
+ * @param task function that executes one job
+ */
+void ThreadPool::parallelFor(uint32_t jobs, function<void(uint32_t job, uint32_t worker)> const&task){
+  {
+    lock_guard<mutex> lock(jobMutex);
+    currentTask = &task;
+    nofJobs = jobs;
+    nextJob = 0;
+    busyWorkers = static_cast<uint32_t>(threads.size());
+    ++generation;
+  }
+  jobsReady.notify_all();
+
+  runJobs(0);
+
+  unique_lock<mutex> lock(jobMutex);
+  jobsDone.wait(lock, [this](){return busyWorkers == 0;});
+  currentTask = nullptr;
+}
+
+void ThreadPool::runJobs(uint32_t worker){
+  for (uint32_t job = nextJob++; job < nofJobs; job = nextJob++)
+    (*currentTask)(job, worker);
+}
+
+void ThreadPool::workerLoop(uint32_t worker){
+  uint64_t seenGeneration = 0;
+  for (;;)
+  {
+    {
+      unique_lock<mutex> lock(jobMutex);
+      jobsReady.wait(lock, [&](){return quit || generation != seenGeneration;});
+      if (quit)
+        return;
+      seenGeneration = generation;
+    }
+
+    runJobs(worker);
+
+    lock_guard<mutex> lock(jobMutex);
+    if (--busyWorkers == 0)
+      jobsDone.notify_one();
+  }
+}
+
+/**
+ * @brief This function adds counters of one statistics to another.
+ *
+ * @param sum accumulated statistics
+ * @param stats added statistics
+ */
+static void accumulateStatistics(GPU::Statistics &sum, GPU::Statistics const&stats)
+{
+    sum.vertexCacheHits += stats.vertexCacheHits;
+    sum.vertexCacheMisses += stats.vertexCacheMisses;
+    sum.outsideTriangles += stats.outsideTriangles;
+    sum.clippedTriangles += stats.clippedTriangles;
+    sum.facingCulled += stats.facingCulled;
+    sum.zeroAreaCulled += stats.zeroAreaCulled;
+    sum.subPixelCulled += stats.subPixelCulled;
+    sum.rasterizedTriangles += stats.rasterizedTriangles;
+    sum.testedPixels += stats.testedPixels;
+    sum.rejectedBlocks += stats.rejectedBlocks;
+    sum.acceptedBlocks += stats.acceptedBlocks;
+    sum.partialBlocks += stats.partialBlocks;
+    sum.hiZRejectedBlocks += stats.hiZRejectedBlocks;
+    sum.fragments += stats.fragments;
+    sum.earlyDepthRejected += stats.earlyDepthRejected;
+    sum.shadedFragments += stats.shadedFragments;
+    sum.depthBytes += stats.depthBytes;
+    for (uint32_t i = 0; i < GPU::nofTriangleSizeClasses; ++i)
+        sum.triangleSizes[i] += stats.triangleSizes[i];
+}
+
 /// \addtogroup gpu_init
 /// @{
 
@@ -18,10 +180,10 @@
  */
 GPU::GPU(){
   /// \todo Zde můžete alokovat/inicializovat potřebné proměnné grafické karty
-  bufferCount = 0;
   vertPullInvCount = 0;
-  pullerCount = 0;
-  programIdCount = 0;
+  activePuller = emptyID;
+  activeProgram = emptyID;
+  binsX = binsY = 0;
 }
 
 /**
@@ -50,9 +212,7 @@ BufferID GPU::createBuffer(uint64_t size) {
   /// Funkce by měla vrátit unikátní identifikátor identifikátor bufferu.<br>
   /// Na grafické kartě by mělo být možné alkovat libovolné množství bufferů o libovolné velikosti.<br>
 
-  //TODO vytvoriť ID tak, aby keď sa vymaže tak sa použilo zase.
-  bufferMap.insert(make_pair(bufferCount, vector<uint8_t>(size)));
-  return bufferCount++;
+  return buffers.insert(vector<uint8_t>(size));
 }
 
 /**
@@ -68,7 +228,9 @@ void GPU::deleteBuffer(BufferID buffer) {
   if (!isBuffer(buffer))
       return;
 
-  bufferMap.erase(bufferMap.find(buffer));
+  buffers.erase(buffer);
+  ++bufferGeneration;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -89,7 +251,7 @@ void GPU::setBufferData(BufferID buffer, uint64_t offset, uint64_t size, void co
   if (!isBuffer(buffer))
       return;
 
-  memcpy(bufferMap[buffer].data() + offset, data, size);
+  memcpy(buffers[buffer].data() + offset, data, size);
 }
 
 /**
@@ -114,7 +276,7 @@ void GPU::getBufferData(BufferID buffer,
   if (!isBuffer(buffer))
       return;
 
-  auto p = bufferMap[buffer].data();
+  auto p = buffers[buffer].data();
   memcpy(data, reinterpret_cast<const void *>(p + offset), size);
 }
 
@@ -133,7 +295,7 @@ bool GPU::isBuffer(BufferID buffer) {
   if (buffer == emptyID)
       return false;
 
-  return bufferMap.find(buffer) != bufferMap.end();
+  return buffers.contains(buffer);
 }
 
 /// @}
@@ -152,8 +314,7 @@ ObjectID GPU::createVertexPuller     (){
   /// \todo Tato funkce vytvoří novou práznou tabulku s nastavením pro vertex puller.<br>
   /// Funkce by měla vrátit identifikátor nové tabulky.
   /// Prázdná tabulka s nastavením neobsahuje indexování a všechny čtecí hlavy jsou vypnuté.
-  vertexPullerMap.insert(make_pair(pullerCount, VertexPullerData{}));
-  return pullerCount++;
+  return vertexPullers.insert(VertexPullerData{});
 }
 
 /**
@@ -169,7 +330,8 @@ void     GPU::deleteVertexPuller     (VertexPullerID vao){
   if (!isVertexPuller(vao))
       return;
 
-  vertexPullerMap.erase(vao);
+  vertexPullers.erase(vao);
+  boundPipelineDirty = true;
 }
 
 /**
@@ -194,12 +356,13 @@ void     GPU::setVertexPullerHead    (VertexPullerID vao,uint32_t head,Attribute
   if (!isVertexPuller(vao))
       return;
 
-  auto data = &vertexPullerMap[vao];
+  auto data = &vertexPullers[vao];
 
   data->head[head].attType = type;
   data->head[head].stride = stride;
   data->head[head].offset = offset;
   data->head[head].bufferId = buffer;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -218,8 +381,9 @@ void     GPU::setVertexPullerIndexing(VertexPullerID vao,IndexType type,BufferID
   if (!isVertexPuller(vao))
       return;
 
-  vertexPullerMap[vao].indexing.bufferId = buffer;
-  vertexPullerMap[vao].indexing.indexType = type;
+  vertexPullers[vao].indexing.bufferId = buffer;
+  vertexPullers[vao].indexing.indexType = type;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -237,7 +401,8 @@ void     GPU::enableVertexPullerHead (VertexPullerID vao,uint32_t head){
   if (!isVertexPuller(vao))
       return;
 
-  vertexPullerMap[vao].head[head].enabled = true;
+  vertexPullers[vao].head[head].enabled = true;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -254,7 +419,8 @@ void     GPU::disableVertexPullerHead(VertexPullerID vao,uint32_t head){
   if (!isVertexPuller(vao))
       return;
 
-  vertexPullerMap[vao].head[head].enabled = true;
+  vertexPullers[vao].head[head].enabled = false;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -270,6 +436,7 @@ void     GPU::bindVertexPuller       (VertexPullerID vao){
       return;
 
   activePuller = vao;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -280,6 +447,7 @@ void     GPU::unbindVertexPuller     (){
   /// To většinou znamená, že se vybere neexistující "emptyID" vertex puller.
 
   activePuller = emptyID;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -292,7 +460,7 @@ void     GPU::unbindVertexPuller     (){
 bool     GPU::isVertexPuller         (VertexPullerID vao){
   /// \todo Tato funkce otestuje, zda daný vertex puller existuje.
   /// Pokud ano, funkce vrací true.
-  return vertexPullerMap.find(vao) != vertexPullerMap.end();
+  return vertexPullers.contains(vao);
 }
 
 /// @}
@@ -312,8 +480,7 @@ ProgramID        GPU::createProgram         (){
   /// Program je seznam nastavení, které obsahuje: ukazatel na vertex a fragment shader.<br>
   /// Dále obsahuje uniformní proměnné a typ výstupních vertex attributů z vertex shaderu, které jsou použity pro interpolaci do fragment atributů.<br>
 
-  programMap.insert(make_pair(programIdCount, ProgramSettings{}));
-  return programIdCount++;
+  return programs.insert(ProgramSettings{});
 }
 
 /**
@@ -329,7 +496,8 @@ void             GPU::deleteProgram         (ProgramID prg){
   if (!isProgram(prg))
       return;
 
-  programMap.erase(prg);
+  programs.erase(prg);
+  boundPipelineDirty = true;
 }
 
 /**
@@ -345,8 +513,39 @@ void             GPU::attachShaders         (ProgramID prg,VertexShader vs,Fragm
   if (!isProgram(prg))
       return;
 
-  programMap[prg].fragmentShader = fs;
-  programMap[prg].vertexShader = vs;
+  programs[prg].fragmentShader = fs;
+  programs[prg].vertexShader = vs;
+  boundPipelineDirty = true;
+}
+
+/**
+ * @brief This function attaches batched vertex shader to shader program.
+ * Batched vertex shader is used instead of vertex shader attached by attachShaders, nullptr detaches it.
+ *
+ * @param prg shader program
+ * @param vs batched vertex shader
+ */
+void             GPU::attachVertexShaderBatch(ProgramID prg,VertexShaderBatch vs){
+  if (!isProgram(prg))
+      return;
+
+  programs[prg].vertexShaderBatch = vs;
+  boundPipelineDirty = true;
+}
+
+/**
+ * @brief This function attaches batched fragment shader to shader program.
+ * Batched fragment shader is used instead of fragment shader attached by attachShaders, nullptr detaches it.
+ *
+ * @param prg shader program
+ * @param fs batched fragment shader
+ */
+void             GPU::attachFragmentShaderBatch(ProgramID prg,FragmentShaderBatch fs){
+  if (!isProgram(prg))
+      return;
+
+  programs[prg].fragmentShaderBatch = fs;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -355,8 +554,9 @@ void             GPU::attachShaders         (ProgramID prg,VertexShader vs,Fragm
  * @param prg shader program
  * @param attrib id of attribute
  * @param type type of attribute
+ * @param interpolation interpolation of the attribute, perspective correct by default
  */
-void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,AttributeType type){
+void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,AttributeType type,Interpolation interpolation){
   /// \todo tato funkce by měla zvolit typ vertex atributu, který je posílán z vertex shaderu do fragment shaderu.<br>
   /// V průběhu rasterizace vznikají fragment.<br>
   /// Fragment obsahují fragment atributy.<br>
@@ -368,7 +568,24 @@ void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,Attri
   if (!isProgram(prg))
       return;
 
-  programMap[prg].attributeType[attrib] = type;
+  programs[prg].attributeType[attrib] = type;
+  programs[prg].interpolation[attrib] = interpolation;
+  boundPipelineDirty = true;
+}
+
+/**
+ * @brief This function selects whether depth test of shader program is performed before fragment shader.
+ * Early depth test is enabled by default, it can be disabled for shaders that require depth test after shading.
+ *
+ * @param prg shader program
+ * @param enable true for early depth test, false for depth test after fragment shader
+ */
+void             GPU::setEarlyDepthTest     (ProgramID prg,bool enable){
+  if (!isProgram(prg))
+      return;
+
+  programs[prg].earlyDepthTest = enable;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -379,6 +596,7 @@ void             GPU::setVS2FSType          (ProgramID prg,uint32_t attrib,Attri
 void             GPU::useProgram            (ProgramID prg){
   /// \todo tato funkce by měla vybrat aktivní shader program.
   activeProgram = prg;
+  boundPipelineDirty = true;
 }
 
 /**
@@ -391,7 +609,7 @@ void             GPU::useProgram            (ProgramID prg){
 bool             GPU::isProgram             (ProgramID prg){
   /// \todo tato funkce by měla zjistit, zda daný program existuje.<br>
   /// Funkce vráti true, pokud program existuje.<br>
-  return programMap.find(prg) != programMap.end();
+  return programs.contains(prg);
 }
 
 /**
@@ -410,7 +628,7 @@ void             GPU::programUniform1f      (ProgramID prg,uint32_t uniformId,fl
   if (!isProgram(prg))
       return;
 
-  programMap[prg].uniforms.uniform[uniformId].v1 = d;
+  programs[prg].uniforms.uniform[uniformId].v1 = d;
 }
 
 /**
@@ -427,7 +645,7 @@ void             GPU::programUniform2f      (ProgramID prg,uint32_t uniformId,gl
   if (!isProgram(prg))
       return;
 
-  programMap[prg].uniforms.uniform[uniformId].v2 = d;
+  programs[prg].uniforms.uniform[uniformId].v2 = d;
 }
 
 /**
@@ -444,7 +662,7 @@ void             GPU::programUniform3f      (ProgramID prg,uint32_t uniformId,gl
   if (!isProgram(prg))
       return;
 
-  programMap[prg].uniforms.uniform[uniformId].v3 = d;
+  programs[prg].uniforms.uniform[uniformId].v3 = d;
 }
 
 /**
@@ -461,7 +679,7 @@ void             GPU::programUniform4f      (ProgramID prg,uint32_t uniformId,gl
   if (!isProgram(prg))
       return;
 
-  programMap[prg].uniforms.uniform[uniformId].v4 = d;
+  programs[prg].uniforms.uniform[uniformId].v4 = d;
 }
 
 /**
@@ -478,7 +696,51 @@ void             GPU::programUniformMatrix4f(ProgramID prg,uint32_t uniformId,gl
   if (!isProgram(prg))
       return;
 
-  programMap[prg].uniforms.uniform[uniformId].m4 = d;
+  programs[prg].uniforms.uniform[uniformId].m4 = d;
+}
+
+/**
+ * @brief This function creates pipeline state object from shader program and vertex puller.
+ * Pipeline is a snapshot, later changes of the program or the vertex puller do not affect it.
+ * Only uniforms of the program and contents of buffers are read when the pipeline is drawn.
+ *
+ * @param prg shader program with attached shaders
+ * @param vao vertex puller, or emptyID for draw without attributes
+ * @param mode cull mode
+ * @param face winding of front-facing triangles
+ *
+ * @return pipeline id, or emptyID if the program or the vertex puller is not valid
+ */
+PipelineID       GPU::createPipeline        (ProgramID prg,VertexPullerID vao,CullMode mode,FrontFace face){
+  ProgramSettings const*program = programs.find(prg);
+  if (!program || (!program->vertexShader && !program->vertexShaderBatch) || (!program->fragmentShader && !program->fragmentShaderBatch))
+      return emptyID;
+  if (vao != emptyID && !isVertexPuller(vao))
+      return emptyID;
+
+  Pipeline pipeline;
+  buildPipeline(pipeline, prg, vao, mode, face);
+  return pipelines.insert(std::move(pipeline));
+}
+
+/**
+ * @brief This function deletes pipeline state object.
+ *
+ * @param pipeline pipeline id
+ */
+void             GPU::deletePipeline        (PipelineID pipeline){
+  pipelines.erase(pipeline);
+}
+
+/**
+ * @brief This function tests if pipeline state object exists.
+ *
+ * @param pipeline pipeline id
+ *
+ * @return true, if pipeline exists
+ */
+bool             GPU::isPipeline            (PipelineID pipeline){
+  return pipelines.contains(pipeline);
 }
 
 /// @}
@@ -496,8 +758,9 @@ void             GPU::programUniformMatrix4f(ProgramID prg,uint32_t uniformId,gl
  *
  * @param width width of framebuffer
  * @param height height of framebuffer
+ * @param depthFormat format of depth buffer
  */
-void GPU::createFramebuffer      (uint32_t width,uint32_t height){
+void GPU::createFramebuffer      (uint32_t width,uint32_t height,DepthFormat depthFormat){
   /// \todo Tato funkce by měla alokovat framebuffer od daném rozlišení.<br>
   /// Framebuffer se skládá z barevného a hloukového bufferu.<br>
   /// Buffery obsahují width x height pixelů.<br>
@@ -505,10 +768,7 @@ void GPU::createFramebuffer      (uint32_t width,uint32_t height){
   /// Hloubkový pixel obsahuje 1 x float - to reprezentuje hloubku.<br>
   /// Nultý pixel framebufferu je vlevo dole.<br>
 
-  ColorBuffer.resize(width * height);
-  DepthBuffer.resize(width * height);
-  frHeight = height;
-  frWidth = width;
+  allocateFramebuffer(width, height, depthFormat);
   clear(0, 0, 0, 0);
 }
 
@@ -520,42 +780,70 @@ void GPU::deleteFramebuffer      (){
 
   ColorBuffer.clear();
   DepthBuffer.clear();
-  frWidth = frHeight = 0;
+  tileCleared.clear();
+  depthTiles.clear();
+  linearColorBuffer.clear();
+  linearDepthBuffer.clear();
+  hiZBuffer.clear();
+  frWidth = frHeight = frTilesX = hiZWidth = 0;
+  colorBufferMapped = depthBufferMapped = false;
+  colorBufferStale = depthBufferStale = true;
 }
 
 /**
- * @brief This function resizes framebuffer.
+ * @brief This function resizes framebuffer, format of depth buffer is kept.
  *
  * @param width new width of framebuffer
  * @param height new heght of framebuffer
  */
 void     GPU::resizeFramebuffer(uint32_t width,uint32_t height){
+  resizeFramebuffer(width, height, depthFormat);
+}
+
+/**
+ * @brief This function resizes framebuffer and changes format of its depth buffer.
+ *
+ * @param width new width of framebuffer
+ * @param height new heght of framebuffer
+ * @param depthFormat format of depth buffer
+ */
+void     GPU::resizeFramebuffer(uint32_t width,uint32_t height,DepthFormat depthFormat){
   /// \todo Tato funkce by měla změnit velikost framebuffer.
 
-  ColorBuffer.resize(width * height);
-  DepthBuffer.resize(width * height);
-  frHeight = height;
-  frWidth = width;
+  allocateFramebuffer(width, height, depthFormat);
+  //resized depth buffer does not keep pixel positions, infinite tile depth never rejects anything
+  for (auto &depth : hiZBuffer)
+      depth = numeric_limits<float>::infinity();
 }
 
 /**
  * @brief This function returns pointer to color buffer.
+ * Pixels written through the pointer are used by draw calls, draw calls are visible through the pointer until the next clear.
+ * Call it again after clear to see the framebuffer.
  *
  * @return pointer to color buffer
  */
 uint8_t* GPU::getFramebufferColor  (){
   /// \todo Tato funkce by měla vrátit ukazatel na začátek barevného bufferu.<br>
-  return &ColorBuffer.data()->r;
+  if (colorBufferStale)
+      resolveLinearFramebuffer(true, false);
+  colorBufferMapped = true;
+  return &linearColorBuffer.data()->r;
 }
 
 /**
  * @brief This function returns pointer to depth buffer.
+ * Depth written through the pointer is used by draw calls, draw calls are visible through the pointer until the next clear.
+ * Call it again after clear to see the framebuffer.
  *
  * @return pointer to dept buffer.
  */
 float* GPU::getFramebufferDepth    (){
   /// \todo tato funkce by mla vrátit ukazatel na začátek hloubkového bufferu.<br>
-  return DepthBuffer.data();
+  if (depthBufferStale)
+      resolveLinearFramebuffer(false, true);
+  depthBufferMapped = true;
+  return linearDepthBuffer.data();
 }
 
 /**
@@ -578,285 +866,2045 @@ uint32_t GPU::getFramebufferHeight(){
   return frHeight;
 }
 
-/// @}
-
-/** \addtogroup draw_tasks 05. Implementace vykreslovacích funkcí
- * Bližší informace jsou uvedeny na hlavní stránce dokumentace.
- * @{
+/**
+ * @brief This function returns format of depth buffer.
+ * Depth buffer pointer always contains floats, unsigned normalized formats are converted when they are read back.
+ *
+ * @return format of depth buffer
  */
+DepthFormat GPU::getFramebufferDepthFormat(){
+  return depthFormat;
+}
 
 /**
- * @brief This functino clears framebuffer.
+ * @brief This function returns number of bytes of one depth buffer pixel.
  *
- * @param r red channel
- * @param g green channel
- * @param b blue channel
- * @param a alpha channel
+ * @param depthFormat format of depth buffer
+ *
+ * @return size of pixel in bytes
  */
-void            GPU::clear                 (float r,float g,float b,float a){
-  /// \todo Tato funkce by měla vyčistit framebuffer.<br>
-  /// Barevný buffer vyčistí na barvu podle parametrů r g b a (0 - nulová intenzita, 1 a větší - maximální intenzita).<br>
-  /// (0,0,0) - černá barva, (1,1,1) - bílá barva.<br>
-  /// Hloubkový buffer nastaví na takovou hodnotu, která umožní rasterizaci trojúhelníka, který leží v rámci pohledového tělesa.<br>
-  /// Hloubka by měla být tedy větší než maximální hloubka v NDC (normalized device coordinates).<br>
+uint32_t GPU::getDepthFormatSize(DepthFormat depthFormat){
+  return depthFormat == DepthFormat::D16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
 
-  for (auto &col : ColorBuffer)
-  {
-      col.r = (r >= 1.0 ? 255 : (r <= 0.0 ? 0 : static_cast<uint8_t>(floor(r * 256.0))));
-      col.g = (g >= 1.0 ? 255 : (g <= 0.0 ? 0 : static_cast<uint8_t>(floor(g * 256.0))));
-      col.b = (b >= 1.0 ? 255 : (b <= 0.0 ? 0 : static_cast<uint8_t>(floor(b * 256.0))));
-      col.a = (a >= 1.0 ? 255 : (a <= 0.0 ? 0 : static_cast<uint8_t>(floor(a * 256.0))));
-  }
-  for (auto &depth : DepthBuffer)
-      depth = 1.f;
+/**
+ * @brief This function returns maximal value of unsigned normalized depth format.
+ *
+ * @param format D24 or D16 depth format
+ *
+ * @return value that represents depth 1
+ */
+static uint32_t unormDepthMax(DepthFormat format)
+{
+    return format == DepthFormat::D16 ? 0xffffu : 0xffffffu;
 }
 
-void            GPU::drawTriangles         (uint32_t  nofVertices){
-  /// \todo Tato funkce vykreslí trojúhelníky podle daného nastavení.<br>
-  /// Vrcholy se budou vybírat podle nastavení z aktivního vertex pulleru (pomocí bindVertexPuller).<br>
-  /// Vertex shader a fragment shader se zvolí podle aktivního shader programu (pomocí useProgram).<br>
-  /// Parametr "nofVertices" obsahuje počet vrcholů, který by se měl vykreslit (3 pro jeden trojúhelník).<br>
-  vertPullInvCount = 0;
+/**
+ * @brief This function converts NDC depth from <-1,1> into unsigned normalized depth.
+ *
+ * @param z depth, it is clamped
+ * @param max value that represents depth 1
+ *
+ * @return unsigned normalized depth
+ */
+static uint32_t depthToUnorm(float z, uint32_t max)
+{
+    return static_cast<uint32_t>(glm::clamp(static_cast<double>(z) * .5 + .5, 0., 1.) * max + .5);
+}
 
-  for (unsigned int i = 0; i < nofVertices; ++i)
-  {
-      OutVertex outVertex;
-      programMap[activeProgram].vertexShader(outVertex, vertexPuller(), programMap[activeProgram].uniforms);
-      outVertexBuffer.push_back(outVertex);
-
-      if (outVertexBuffer.size() % 3 == 0)
-      {
-          PrimitiveTriangle triangle = primitiveAssembly();
-          rasterize(triangle);
-      }
-  }
+/**
+ * @brief This function converts unsigned normalized depth into NDC depth.
+ *
+ * @param depth unsigned normalized depth
+ * @param max value that represents depth 1
+ *
+ * @return depth in <-1,1>
+ */
+static float unormToDepth(uint32_t depth, uint32_t max)
+{
+    return static_cast<float>(static_cast<double>(depth) / max * 2. - 1.);
 }
 
-InVertex GPU::vertexPuller()
+/**
+ * @brief This function computes position of a pixel in tiled framebuffer storage.
+ * Tiles are stored in row-major order, pixels inside a tile are Morton ordered,
+ * so each 2x2 quad and each rasterization stamp occupy consecutive pixels.
+ *
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ *
+ * @return index of the pixel in ColorBuffer and DepthBuffer
+ */
+uint32_t GPU::framebufferPixel(uint32_t x, uint32_t y) const
 {
-    InVertex inVertex;
+    static_assert(framebufferTileSize == 4, "Morton order is implemented for 4x4 tiles");
+    uint32_t const tile = (y / framebufferTileSize) * frTilesX + x / framebufferTileSize;
+    uint32_t const morton = (x & 1u) | ((y & 1u) << 1) | ((x & 2u) << 1) | ((y & 2u) << 2);
+    return tile * framebufferTilePixels + morton;
+}
 
-    auto pullerData = &vertexPullerMap[activePuller];
+/**
+ * @brief This function allocates tiled framebuffer storage and hierarchical depth buffer.
+ * Linear copies of buffers are released, pointers handed out before are no longer valid.
+ *
+ * @param width width of framebuffer
+ * @param height height of framebuffer
+ * @param format format of depth buffer
+ */
+void GPU::allocateFramebuffer(uint32_t width, uint32_t height, DepthFormat format)
+{
+    depthFormat = format;
+    depthTexelSize = getDepthFormatSize(format);
+    frWidth = width;
+    frHeight = height;
+    frTilesX = (width + framebufferTileSize - 1) / framebufferTileSize;
+    uint32_t const tilesY = (height + framebufferTileSize - 1) / framebufferTileSize;
+    ColorBuffer.resize(frTilesX * tilesY * framebufferTilePixels);
+    DepthBuffer.resize(frTilesX * tilesY * framebufferTilePixels * depthTexelSize);
+    tileCleared.resize(frTilesX * tilesY);
+    depthTiles.assign(frTilesX * tilesY, DepthTile{});
+    hiZWidth = (width + rasterBlockSize - 1) / rasterBlockSize;
+    hiZBuffer.resize(hiZWidth * ((height + rasterBlockSize - 1) / rasterBlockSize));
+
+    linearColorBuffer.clear();
+    linearDepthBuffer.clear();
+    colorBufferMapped = depthBufferMapped = false;
+    colorBufferStale = depthBufferStale = true;
+}
 
-    uint8_t dataSize;
+/**
+ * @brief This function rounds depth to the nearest value representable by depth buffer format.
+ * Depth test compares rounded depth of fragment with stored depth.
+ *
+ * @param z depth of fragment
+ *
+ * @return depth that would be read back after it is stored
+ */
+float GPU::quantizeDepth(float z) const
+{
+    if (depthFormat == DepthFormat::D32F)
+        return z;
+    return unormToDepth(depthToUnorm(z, unormDepthMax(depthFormat)), unormDepthMax(depthFormat));
+}
 
-    inVertex.gl_VertexID = vertPullInvCount;
-    if (pullerData->indexing.bufferId != emptyID)
+/**
+ * @brief This function reads one pixel of tiled depth buffer.
+ *
+ * @param pixel index of pixel in tiled storage
+ *
+ * @return depth in <-1,1>
+ */
+float GPU::loadDepth(uint32_t pixel) const
+{
+    uint8_t const*texel = DepthBuffer.data() + pixel * depthTexelSize;
+    switch (depthFormat)
     {
-        switch (pullerData->indexing.indexType)
+        case DepthFormat::D16:
         {
-            case IndexType::UINT8:
-                dataSize = sizeof(uint8_t);
-                break;
-            case IndexType::UINT16:
-                dataSize = sizeof(uint16_t);
-                break;
-            case IndexType::UINT32:
-                dataSize = sizeof(uint32_t);
-                break;
+            uint16_t depth;
+            memcpy(&depth, texel, sizeof(uint16_t));
+            return unormToDepth(depth, unormDepthMax(depthFormat));
+        }
+        case DepthFormat::D24:
+        {
+            uint32_t depth;
+            memcpy(&depth, texel, sizeof(uint32_t));
+            return unormToDepth(depth, unormDepthMax(depthFormat));
+        }
+        default:
+        {
+            float depth;
+            memcpy(&depth, texel, sizeof(float));
+            return depth;
         }
-        getBufferData(pullerData->indexing.bufferId, vertPullInvCount * dataSize, dataSize, &inVertex.gl_VertexID);
     }
+}
 
-    for (int i = 0; i < maxAttributes; ++i)
+/**
+ * @brief This function writes one pixel of tiled depth buffer.
+ *
+ * @param pixel index of pixel in tiled storage
+ * @param z depth in <-1,1>, unsigned normalized formats clamp it
+ */
+void GPU::storeDepth(uint32_t pixel, float z)
+{
+    uint8_t *texel = DepthBuffer.data() + pixel * depthTexelSize;
+    switch (depthFormat)
     {
-        switch (pullerData->head[i].attType)
+        case DepthFormat::D16:
         {
-            case AttributeType::EMPTY:
-                dataSize = 0;
-                break;
-            case AttributeType::FLOAT:
-                dataSize = sizeof(float);
-                break;
-            case AttributeType::VEC2:
-                dataSize = sizeof(float) * 2;
-                break;
-            case AttributeType::VEC3:
-                dataSize = sizeof(float) * 3;
-                break;
-            case AttributeType::VEC4:
-                dataSize = sizeof(float) * 4;
-                break;
+            uint16_t const depth = static_cast<uint16_t>(depthToUnorm(z, unormDepthMax(depthFormat)));
+            memcpy(texel, &depth, sizeof(uint16_t));
+            break;
         }
-
-        getBufferData(pullerData->head[i].bufferId, pullerData->head[i].offset + pullerData->head[i].stride * inVertex.gl_VertexID,
-                dataSize, &inVertex.attributes[i]);
+        case DepthFormat::D24:
+        {
+            uint32_t const depth = depthToUnorm(z, unormDepthMax(depthFormat));
+            memcpy(texel, &depth, sizeof(uint32_t));
+            break;
+        }
+        default:
+            memcpy(texel, &z, sizeof(float));
+            break;
     }
-
-    ++vertPullInvCount;
-    return inVertex;
 }
 
-GPU::PrimitiveTriangle GPU::primitiveAssembly()
+/**
+ * @brief This function writes clear values into all pixels of a cleared framebuffer tile.
+ *
+ * @param tile index of framebuffer tile
+ */
+void GPU::materializeTile(uint32_t tile)
 {
-    PrimitiveTriangle triangle;
-
-    OutVertex vertex;
-    vertex = perspectiveDivision(outVertexBuffer.back());
-    triangle.c = viewPortTransformation(vertex);
-    outVertexBuffer.pop_back();
-
-    vertex = perspectiveDivision(outVertexBuffer.back());
-    triangle.b = viewPortTransformation(vertex);
-    outVertexBuffer.pop_back();
-
-    vertex = perspectiveDivision(outVertexBuffer.back());
-    triangle.a = viewPortTransformation(vertex);
-    outVertexBuffer.pop_back();
+    for (uint32_t i = tile * framebufferTilePixels; i < (tile + 1) * framebufferTilePixels; ++i)
+        ColorBuffer[i] = clearColor;
 
-    return triangle;
+    //with depth compression, all pixels of the tile select the clear plane
+    DepthTile &depthTile = depthTiles[tile];
+    depthTile.nofPlanes = 0;
+    if (depthCompression)
+    {
+        depthTile.planes[0] = 0;
+        depthTile.selectors = 0;
+        depthTile.nofPlanes = 1;
+    }
+    else
+    {
+        for (uint32_t i = tile * framebufferTilePixels; i < (tile + 1) * framebufferTilePixels; ++i)
+            storeDepth(i, clearDepth);
+    }
+    tileCleared[tile] = 0;
 }
 
-OutVertex GPU::perspectiveDivision(OutVertex &vertex)
+/**
+ * @brief This function evaluates depth plane at a pixel exactly like depth of fragment is computed.
+ *
+ * @param plane depth plane
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ *
+ * @return depth rounded to depth buffer format
+ */
+float GPU::planeDepth(DepthPlane const&plane, uint32_t x, uint32_t y) const
 {
-    vertex.gl_Position.x /= vertex.gl_Position.w;
-    vertex.gl_Position.y /= vertex.gl_Position.w;
-    vertex.gl_Position.z /= vertex.gl_Position.w;
-    return vertex;
+    float const dx = static_cast<float>(static_cast<int32_t>(x) - plane.originX);
+    float const dy = static_cast<float>(static_cast<int32_t>(y) - plane.originY);
+    return quantizeDepth(glm::clamp(plane.depth.at(dx, dy), plane.minZ, plane.maxZ));
 }
 
-OutVertex GPU::viewPortTransformation(OutVertex &vertex)
+/**
+ * @brief This function reads depth of a pixel from cleared, compressed or uncompressed tile.
+ *
+ * @param pixel index of pixel in tiled storage
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ *
+ * @return depth in <-1,1>
+ */
+float GPU::readDepth(uint32_t pixel, uint32_t x, uint32_t y) const
 {
-    vertex.gl_Position.x += 1.f;
-    vertex.gl_Position.y += 1.f;
+    uint32_t const tile = pixel / framebufferTilePixels;
+    if (tileCleared[tile])
+        return clearDepth;
 
-    vertex.gl_Position.x /= 2.f;
-    vertex.gl_Position.y /= 2.f;
+    DepthTile const&depthTile = depthTiles[tile];
+    if (!depthTile.nofPlanes)
+        return loadDepth(pixel);
 
-    vertex.gl_Position.x *= static_cast<float>(getFramebufferWidth());
-    vertex.gl_Position.y *= static_cast<float>(getFramebufferHeight());
-    return vertex;
+    uint32_t const slot = (depthTile.selectors >> (2 * (pixel % framebufferTilePixels))) & 3u;
+    return planeDepth(depthPlanes[depthTile.planes[slot]], x, y);
 }
 
-void GPU::rasterize(PrimitiveTriangle &triangle)
+/**
+ * @brief This function writes depth of a pixel of a materialized tile.
+ * Compressed tile selects the plane of the triangle for the pixel. It is decompressed if it has no free plane slot
+ * or if the plane does not reproduce the depth exactly.
+ *
+ * @param pixel index of pixel in tiled storage
+ * @param x x coordinate of the pixel
+ * @param y y coordinate of the pixel
+ * @param z depth rounded to depth buffer format
+ * @param plane index of depth plane of the triangle in depthPlanes
+ */
+void GPU::writeDepth(uint32_t pixel, uint32_t x, uint32_t y, float z, uint32_t plane)
 {
-//    if (((triangle.b.gl_Position.x - triangle.a.gl_Position.x) * (triangle.c.gl_Position.y - triangle.a.gl_Position.y) - ((triangle.b.gl_Position.y - triangle.a.gl_Position.y) * (triangle.c.gl_Position.x - triangle.a.gl_Position.x))) > 0)
-//    {
-//        swap(triangle.b, triangle.c);
-//    }
+    uint32_t const tile = pixel / framebufferTilePixels;
+    DepthTile &depthTile = depthTiles[tile];
+    if (depthTile.nofPlanes)
+    {
+        uint32_t slot = 0;
+        while (slot < depthTile.nofPlanes && depthTile.planes[slot] != plane)
+            ++slot;
+
+        if (slot == maxTilePlanes)
+        {
+            //slot that is not selected by any pixel is reused
+            uint32_t used = 0;
+            for (uint32_t i = 0; i < framebufferTilePixels; ++i)
+                used |= 1u << ((depthTile.selectors >> (2 * i)) & 3u);
+            slot = 0;
+            while (slot < maxTilePlanes && ((used >> slot) & 1u))
+                ++slot;
+            if (slot < maxTilePlanes)
+                depthTile.planes[slot] = plane;
+        }
+        else if (slot == depthTile.nofPlanes)
+            depthTile.planes[depthTile.nofPlanes++] = plane;
+
+        if (slot < maxTilePlanes && planeDepth(depthPlanes[plane], x, y) == z)
+        {
+            uint32_t const shift = 2 * (pixel % framebufferTilePixels);
+            depthTile.selectors = (depthTile.selectors & ~(3u << shift)) | (slot << shift);
+            return;
+        }
+        decompressTile(tile);
+    }
+    storeDepth(pixel, z);
+}
 
-    float deltaAB_x = triangle.b.gl_Position.x - triangle.a.gl_Position.x;
-    float deltaAB_y = triangle.b.gl_Position.y - triangle.a.gl_Position.y;
+/**
+ * @brief This function returns number of bytes that are accessed when pixels of a tile are read or written by depth test.
+ * Compressed tile is accessed through its selectors and plane indices, plane table is shared by all tiles.
+ *
+ * @param tile index of framebuffer tile
+ * @param nofPixels number of accessed pixels
+ *
+ * @return number of bytes
+ */
+uint32_t GPU::depthTileBytes(uint32_t tile, uint32_t nofPixels) const
+{
+    uint32_t const nofPlanes = depthTiles[tile].nofPlanes;
+    if (!nofPlanes)
+        return nofPixels * depthTexelSize;
+    return nofPixels ? (nofPlanes + 1) * static_cast<uint32_t>(sizeof(uint32_t)) : 0;
+}
 
-    float deltaBC_x = triangle.c.gl_Position.x - triangle.b.gl_Position.x;
-    float deltaBC_y = triangle.c.gl_Position.y - triangle.b.gl_Position.y;
+/**
+ * @brief This function stores depth of compressed tile uncompressed into DepthBuffer.
+ *
+ * @param tile index of framebuffer tile
+ */
+void GPU::decompressTile(uint32_t tile)
+{
+    uint32_t const tileX = (tile % frTilesX) * framebufferTileSize;
+    uint32_t const tileY = (tile / frTilesX) * framebufferTileSize;
+    float depths[framebufferTilePixels];
+    for (uint32_t y = tileY; y < tileY + framebufferTileSize; ++y)
+        for (uint32_t x = tileX; x < tileX + framebufferTileSize; ++x)
+        {
+            uint32_t const pixel = framebufferPixel(x, y);
+            depths[pixel % framebufferTilePixels] = readDepth(pixel, x, y);
+        }
 
-    float deltaCA_x = triangle.a.gl_Position.x - triangle.c.gl_Position.x;
-    float deltaCA_y = triangle.a.gl_Position.y - triangle.c.gl_Position.y;
+    depthTiles[tile].nofPlanes = 0;
+    for (uint32_t i = 0; i < framebufferTilePixels; ++i)
+        storeDepth(tile * framebufferTilePixels + i, depths[i]);
+}
 
-//    float EAB = (0 + 0.5f - triangle.a.gl_Position.x) * deltaAB_y - (0 + 0.5f - triangle.a.gl_Position.y) * deltaAB_x;
-//    float EBC = (0 + 0.5f - triangle.b.gl_Position.x) * deltaBC_y - (0 + 0.5f - triangle.b.gl_Position.y) * deltaBC_x;
-//    float ECA = (0 + 0.5f - triangle.c.gl_Position.x) * deltaCA_y - (0 + 0.5f - triangle.c.gl_Position.y) * deltaCA_x;
+/**
+ * @brief This function decompresses all compressed depth tiles.
+ */
+void GPU::decompressDepthTiles()
+{
+    for (uint32_t tile = 0; tile < depthTiles.size(); ++tile)
+        if (!tileCleared[tile] && depthTiles[tile].nofPlanes)
+            decompressTile(tile);
+}
 
-    for (unsigned int y = 0; y < getFramebufferHeight(); ++y)
-    {
-        for (unsigned int x = 0; x < getFramebufferWidth(); ++x)
+/**
+ * @brief This function copies linear buffers handed out by getFramebufferColor and getFramebufferDepth into tiled storage.
+ * It is called before drawing while pointers are mapped, because the buffers could have been written through them.
+ * Cleared tiles whose pixels were not changed through the pointers stay cleared.
+ */
+void GPU::loadMappedFramebuffer()
+{
+    uint32_t const tilesY = static_cast<uint32_t>(tileCleared.size()) / glm::max(frTilesX, 1u);
+    for (uint32_t tileY = 0; tileY < tilesY; ++tileY)
+        for (uint32_t tileX = 0; tileX < frTilesX; ++tileX)
         {
-            float EAB{(static_cast<float>(x) + 0.5f - triangle.a.gl_Position.x) * deltaAB_y - (static_cast<float>(y) + 0.5f - triangle.a.gl_Position.y) * deltaAB_x};
-            float EBC{(static_cast<float>(x) + 0.5f - triangle.b.gl_Position.x) * deltaBC_y - (static_cast<float>(y) + 0.5f - triangle.b.gl_Position.y) * deltaBC_x};
-            float ECA{(static_cast<float>(x) + 0.5f - triangle.c.gl_Position.x) * deltaCA_y - (static_cast<float>(y) + 0.5f - triangle.c.gl_Position.y) * deltaCA_x};
+            uint32_t const tile = tileY * frTilesX + tileX;
+            uint32_t const endX = glm::min((tileX + 1) * framebufferTileSize, frWidth);
+            uint32_t const endY = glm::min((tileY + 1) * framebufferTileSize, frHeight);
 
-            if ((EAB >= 0 && EBC >= 0 && ECA >= 0) || (EAB <= 0 && EBC <= 0 && ECA <= 0))
+            if (tileCleared[tile])
             {
-                InFragment fragment;
-                fragment.gl_FragCoord.x = static_cast<float>(x) + 0.5f;
-                fragment.gl_FragCoord.y = static_cast<float>(y) + 0.5f;
-
-                glm::vec2 p {static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f};
-                interpolate(fragment, p, triangle.a, triangle.b, triangle.c);
+                bool changed = false;
+                for (uint32_t y = tileY * framebufferTileSize; y < endY; ++y)
+                    for (uint32_t x = tileX * framebufferTileSize; x < endX; ++x)
+                    {
+                        if (colorBufferMapped)
+                            changed |= memcmp(&linearColorBuffer[y * frWidth + x], &clearColor, sizeof(RGBColor)) != 0;
+                        if (depthBufferMapped)
+                            changed |= linearDepthBuffer[y * frWidth + x] != clearDepth;
+                    }
+                if (!changed)
+                    continue;
+                materializeTile(tile);
+            }
 
-                OutFragment outFragment{};
-                programMap[activeProgram].fragmentShader(outFragment, fragment, programMap[activeProgram].uniforms);
+            //compressed depth tile stays compressed if its depth was not changed through the pointer
+            if (depthBufferMapped && depthTiles[tile].nofPlanes)
+            {
+                bool changed = false;
+                for (uint32_t y = tileY * framebufferTileSize; y < endY; ++y)
+                    for (uint32_t x = tileX * framebufferTileSize; x < endX; ++x)
+                        changed |= linearDepthBuffer[y * frWidth + x] != readDepth(framebufferPixel(x, y), x, y);
+                if (changed)
+                    decompressTile(tile);
+            }
 
-                if (fragment.gl_FragCoord.z < DepthBuffer[x * getFramebufferWidth() + y])
+            for (uint32_t y = tileY * framebufferTileSize; y < endY; ++y)
+                for (uint32_t x = tileX * framebufferTileSize; x < endX; ++x)
                 {
-                    ColorBuffer[x * getFramebufferWidth() + y].r = (outFragment.gl_FragColor.r >= 1.0 ? 255 : (outFragment.gl_FragColor.r <= 0.0 ? 0 : static_cast<uint8_t>(floor(outFragment.gl_FragColor.r * 256.0))));
-                    ColorBuffer[x * getFramebufferWidth() + y].g = (outFragment.gl_FragColor.g >= 1.0 ? 255 : (outFragment.gl_FragColor.g <= 0.0 ? 0 : static_cast<uint8_t>(floor(outFragment.gl_FragColor.g * 256.0))));
-                    ColorBuffer[x * getFramebufferWidth() + y].b = (outFragment.gl_FragColor.b >= 1.0 ? 255 : (outFragment.gl_FragColor.b <= 0.0 ? 0 : static_cast<uint8_t>(floor(outFragment.gl_FragColor.b * 256.0))));
-                    ColorBuffer[x * getFramebufferWidth() + y].a = (outFragment.gl_FragColor.a >= 1.0 ? 255 : (outFragment.gl_FragColor.a <= 0.0 ? 0 : static_cast<uint8_t>(floor(outFragment.gl_FragColor.a * 256.0))));
-
-                    DepthBuffer[x * getFramebufferWidth() + y] = fragment.gl_FragCoord.z;
+                    uint32_t const pixel = framebufferPixel(x, y);
+                    if (colorBufferMapped)
+                        ColorBuffer[pixel] = linearColorBuffer[y * frWidth + x];
+                    if (depthBufferMapped && !depthTiles[tile].nofPlanes)
+                        storeDepth(pixel, linearDepthBuffer[y * frWidth + x]);
                 }
-            }
-//            EAB += deltaAB_x;
-//            EBC += deltaBC_x;
-//            ECA += deltaCA_x;
         }
-//        EAB -= deltaAB_y;
-//        EBC -= deltaBC_y;
-//        ECA -= deltaCA_y;
-    }
 
+    if (depthBufferMapped)
+        rebuildHiZ();
 }
 
-void GPU::interpolate(InFragment &fragment, glm::vec2 &p, OutVertex &a, OutVertex &b, OutVertex &c)
+/**
+ * @brief This function resolves tiled storage into linear row-major buffers.
+ * Resolved buffers are no longer stale, their pointers stay valid until the framebuffer is reallocated.
+ *
+ * @param color resolve color buffer
+ * @param depth resolve depth buffer
+ */
+void GPU::resolveLinearFramebuffer(bool color, bool depth)
 {
-    //source https://gamedev.stackexchange.com/questions/23743/whats-the-most-efficient-way-to-find-barycentric-coordinates
+    if (color)
+    {
+        linearColorBuffer.resize(frWidth * frHeight);
+        colorBufferStale = false;
+    }
+    if (depth)
+    {
+        linearDepthBuffer.resize(frWidth * frHeight);
+        depthBufferStale = false;
+    }
+
+    uint32_t const tilesY = static_cast<uint32_t>(tileCleared.size()) / glm::max(frTilesX, 1u);
+    for (uint32_t tileY = 0; tileY < tilesY; ++tileY)
+        for (uint32_t tileX = 0; tileX < frTilesX; ++tileX)
+        {
+            uint32_t const tile = tileY * frTilesX + tileX;
+            uint32_t const beginX = tileX * framebufferTileSize;
+            uint32_t const endX = glm::min(beginX + framebufferTileSize, frWidth);
+            uint32_t const endY = glm::min((tileY + 1) * framebufferTileSize, frHeight);
+
+            //cleared tile is filled with clear values, its tiled storage is not touched
+            if (tileCleared[tile])
+            {
+                for (uint32_t y = tileY * framebufferTileSize; y < endY; ++y)
+                {
+                    if (color)
+                        std::fill(linearColorBuffer.begin() + y * frWidth + beginX, linearColorBuffer.begin() + y * frWidth + endX, clearColor);
+                    if (depth)
+                        std::fill(linearDepthBuffer.begin() + y * frWidth + beginX, linearDepthBuffer.begin() + y * frWidth + endX, clearDepth);
+                }
+                continue;
+            }
+
+            for (uint32_t y = tileY * framebufferTileSize; y < endY; ++y)
+                for (uint32_t x = beginX; x < endX; ++x)
+                {
+                    uint32_t const pixel = framebufferPixel(x, y);
+                    if (color)
+                        linearColorBuffer[y * frWidth + x] = ColorBuffer[pixel];
+                    if (depth)
+                        linearDepthBuffer[y * frWidth + x] = readDepth(pixel, x, y);
+                }
+        }
+}
+
+/// @}
+
+/**
+ * @brief This function returns counters collected during drawing since the last reset.
+ *
+ * @return drawing statistics
+ */
+GPU::Statistics const&GPU::getStatistics(){
+  return statistics;
+}
+
+/**
+ * @brief This function resets counters collected during drawing.
+ */
+void GPU::resetStatistics(){
+  statistics = Statistics{};
+}
+
+/** \addtogroup draw_tasks 05. Implementace vykreslovacích funkcí
+ * Bližší informace jsou uvedeny na hlavní stránce dokumentace.
+ * @{
+ */
+
+/**
+ * @brief This functino clears framebuffer.
+ *
+ * @param r red channel
+ * @param g green channel
+ * @param b blue channel
+ * @param a alpha channel
+ */
+void            GPU::clear                 (float r,float g,float b,float a){
+  /// \todo Tato funkce by měla vyčistit framebuffer.<br>
+  /// Barevný buffer vyčistí na barvu podle parametrů r g b a (0 - nulová intenzita, 1 a větší - maximální intenzita).<br>
+  /// (0,0,0) - černá barva, (1,1,1) - bílá barva.<br>
+  /// Hloubkový buffer nastaví na takovou hodnotu, která umožní rasterizaci trojúhelníka, který leží v rámci pohledového tělesa.<br>
+  /// Hloubka by měla být tedy větší než maximální hloubka v NDC (normalized device coordinates).<br>
+
+  //only clear values are recorded, pixels of a tile are written when the tile is accessed first
+  clearColor.r = (r >= 1.0 ? 255 : (r <= 0.0 ? 0 : static_cast<uint8_t>(floor(r * 256.0))));
+  clearColor.g = (g >= 1.0 ? 255 : (g <= 0.0 ? 0 : static_cast<uint8_t>(floor(g * 256.0))));
+  clearColor.b = (b >= 1.0 ? 255 : (b <= 0.0 ? 0 : static_cast<uint8_t>(floor(b * 256.0))));
+  clearColor.a = (a >= 1.0 ? 255 : (a <= 0.0 ? 0 : static_cast<uint8_t>(floor(a * 256.0))));
+  clearDepth = 1.f;
+  for (auto &tag : tileCleared)
+      tag = 1;
+  //cleared tiles do not reference any plane, so planes of previous triangles are released
+  DepthPlane clearPlane;
+  clearPlane.depth = {clearDepth, 0.f, 0.f};
+  clearPlane.originX = clearPlane.originY = 0;
+  clearPlane.minZ = clearPlane.maxZ = clearDepth;
+  depthPlanes.assign(1, clearPlane);
+  for (auto &depth : hiZBuffer)
+      depth = 1.f;
+  //clear overwrites pixels written through pointers, the pointers stop following the framebuffer
+  colorBufferMapped = depthBufferMapped = false;
+  colorBufferStale = depthBufferStale = true;
+}
+
+void            GPU::drawTriangles         (uint32_t  nofVertices){
+  /// \todo Tato funkce vykreslí trojúhelníky podle daného nastavení.<br>
+  /// Vrcholy se budou vybírat podle nastavení z aktivního vertex pulleru (pomocí bindVertexPuller).<br>
+  /// Vertex shader a fragment shader se zvolí podle aktivního shader programu (pomocí useProgram).<br>
+  /// Parametr "nofVertices" obsahuje počet vrcholů, který by se měl vykreslit (3 pro jeden trojúhelník).<br>
+
+  if (!isProgram(activeProgram))
+      return;
+
+  if (boundPipelineDirty)
+      buildPipeline(boundPipeline, activeProgram, activePuller, cullMode, frontFace);
+
+  draw(boundPipeline, nofVertices);
+}
+
+/**
+ * @brief This function draws triangles using pipeline state object.
+ * Draw call is skipped if the shader program of the pipeline or a buffer used by it was deleted.
+ *
+ * @param pipeline pipeline id
+ * @param nofVertices number of vertices
+ */
+void            GPU::drawTriangles         (PipelineID pipeline,uint32_t nofVertices){
+  Pipeline *state = pipelines.find(pipeline);
+  if (!state || !isProgram(state->program) || !validateFetchPlan(*state))
+      return;
+
+  draw(*state, nofVertices);
+}
+
+/**
+ * @brief This function builds pipeline state object.
+ *
+ * @param pipeline output pipeline
+ * @param prg existing shader program
+ * @param vao vertex puller
+ * @param mode cull mode
+ * @param face winding of front-facing triangles
+ */
+void GPU::buildPipeline(Pipeline &pipeline, ProgramID prg, VertexPullerID vao, CullMode mode, FrontFace face)
+{
+    ProgramSettings const&program = programs[prg];
+    pipeline.vertexShader = program.vertexShader;
+    pipeline.vertexShaderBatch = program.vertexShaderBatch;
+    pipeline.fragmentShader = program.fragmentShader;
+    pipeline.fragmentShaderBatch = program.fragmentShaderBatch;
+    pipeline.uniforms = &program.uniforms;
+    pipeline.nofVaryings = 0;
+    pipeline.vertexStride = 4;
+    pipeline.perspective = false;
+    for (uint32_t i = 0; i < maxAttributes; ++i)
+    {
+        uint32_t const nofComponents = static_cast<uint32_t>(program.attributeType[i]);
+        if (nofComponents == 0)
+            continue;
+        pipeline.varyings[pipeline.nofVaryings++] = {i, nofComponents, program.interpolation[i]};
+        pipeline.vertexStride += nofComponents;
+        pipeline.perspective |= program.interpolation[i] == Interpolation::SMOOTH;
+    }
+    pipeline.interpolate = selectInterpolator(pipeline);
+    pipeline.earlyDepthTest = program.earlyDepthTest;
+    pipeline.cullMode = mode;
+    pipeline.frontFace = face;
+    buildFetchPlan(pipeline.fetchPlan, vao);
+    pipeline.program = prg;
+    pipeline.bufferGeneration = bufferGeneration;
+    if (&pipeline == &boundPipeline)
+        boundPipelineDirty = false;
+}
+
+/**
+ * @brief This function checks that buffers of pipeline's fetch plan were not deleted.
+ *
+ * @param pipeline pipeline
+ *
+ * @return true, if all buffers used by the fetch plan exist
+ */
+bool GPU::validateFetchPlan(Pipeline &pipeline)
+{
+    if (pipeline.bufferGeneration == bufferGeneration)
+        return true;
+
+    FetchPlan const&plan = pipeline.fetchPlan;
+    if (plan.indexBuffer != emptyID && !isBuffer(plan.indexBuffer))
+        return false;
+    for (uint32_t i = 0; i < plan.nofHeads; ++i)
+        if (!isBuffer(plan.heads[i].buffer))
+            return false;
+
+    pipeline.bufferGeneration = bufferGeneration;
+    return true;
+}
+
+/**
+ * @brief This function executes draw call of a pipeline.
+ *
+ * @param pipeline valid pipeline
+ * @param nofVertices number of vertices
+ */
+void GPU::draw(Pipeline &pipeline, uint32_t nofVertices)
+{
+    vertPullInvCount = 0;
+
+    //mapped buffers could have been written through their pointers
+    if (colorBufferMapped || depthBufferMapped)
+        loadMappedFramebuffer();
 
-    glm::vec2 v0 = {b.gl_Position - a.gl_Position},
-            v1 = {c.gl_Position - a.gl_Position},
-            v2 = {p.x - a.gl_Position.x, p.y - a.gl_Position.y};
+    //frames without clear would grow plane table without limit
+    if (depthCompression && depthPlanes.size() > maxDepthPlanes)
+    {
+        decompressDepthTiles();
+        depthPlanes.resize(1);
+    }
 
-//    glm::vec2 v0 = {b.gl_Position - a.gl_Position},
-//    v1 = {c.gl_Position - a.gl_Position},
-//    v2 = {p.x - a.gl_Position.x, p.y - a.gl_Position.y};
-    float d00 = glm::dot(v0, v0);
-    float d01 = glm::dot(v0, v1);
-    float d11 = glm::dot(v1, v1);
-    float d20 = glm::dot(v2, v0);
-    float d21 = glm::dot(v2, v1);
-    float denom = d00 * d11 - d01 * d01;
+    //programs can be moved in their storage, uniforms are resolved once per draw call
+    pipeline.uniforms = &programs[pipeline.program].uniforms;
+    bool const binned = threadPool != nullptr;
 
-//    float l0 = ((d11 * d20 - d01 * d21) / denom);
-//    float l1 = ((d00 * d21 - d01 * d20) / denom);
-//    float l2 = 1.0f - l0 - l1;
+    RasterContext context;
+    context.pipeline = &pipeline;
+    context.rect = {0, 0, static_cast<int32_t>(getFramebufferWidth()) - 1, static_cast<int32_t>(getFramebufferHeight()) - 1};
 
-    float l1 = (d11 * d20 - d01 * d21) / denom;
-    float l2 = (d00 * d21 - d01 * d20) / denom;
-    float l0 = 1.0f - l1 - l2;
+    if (binned)
+    {
+        binsX = (getFramebufferWidth() + binTileSize - 1) / binTileSize;
+        binsY = (getFramebufferHeight() + binTileSize - 1) / binTileSize;
+        bins.resize(binsX * binsY);
+    }
 
-    float h0 = a.gl_Position.w;
-    float h1 = b.gl_Position.w;
-    float h2 = c.gl_Position.w;
+    processVertices(pipeline, nofVertices);
 
-    Attribute A0, A1, A2;
-    for (unsigned int i = 0; i < maxAttributes; ++i)
+    TriangleSetup setup;
+    float const*polygon[maxClippedVertices];
+    float intersections[maxClipIntersections * maxVertexFloats];
+    uint32_t const stride = pipeline.vertexStride;
+    for (uint32_t i = 0; i + 2 < nofVertices; i += 3)
     {
-        switch (programMap[activeProgram].attributeType[i])
+        polygon[0] = shadedVertices.data() + vertexSlots[i + 0] * stride;
+        polygon[1] = shadedVertices.data() + vertexSlots[i + 1] * stride;
+        polygon[2] = shadedVertices.data() + vertexSlots[i + 2] * stride;
+        //flat varyings of all triangles of clipped polygon come from the first vertex of the original triangle
+        float const*provoking = polygon[0] + 4;
+
+        //clipped polygon is convex, it is split into triangle fan
+        uint32_t const nofPolygonVertices = clipTriangle(polygon, intersections, pipeline);
+        for (uint32_t k = 1; k + 1 < nofPolygonVertices; ++k)
         {
-            case AttributeType::EMPTY:
-                break;
-            case AttributeType::FLOAT:
-                A0.v1 = a.attributes[i].v1;
-                A1.v1 = b.attributes[i].v1;
-                A2.v1 = c.attributes[i].v1;
+            PrimitiveTriangle triangle = primitiveAssembly(polygon[0], polygon[k], polygon[k + 1], provoking);
+            if (!triangleSetup(setup, pipeline, triangle))
+                continue;
 
-                fragment.attributes[i].v1 = (((A0.v1 * l0 / h0) + (A1.v1 * l1 / h1) + (A2.v1 * l2 / h2)) / (l0 / h0 + l1 / h1 + l2 / h2));
-                break;
-            case AttributeType::VEC2:
-                A0.v2 = a.attributes[i].v2;
-                A1.v2 = b.attributes[i].v2;
-                A2.v2 = c.attributes[i].v2;
+            //plane is registered before rasterization, workers only read the plane table
+            if (depthCompression)
+            {
+                setup.depthPlane = static_cast<uint32_t>(depthPlanes.size());
+                depthPlanes.push_back({setup.depth, setup.bounds.minX, setup.bounds.minY, setup.minZ, setup.maxZ});
+            }
 
-                fragment.attributes[i].v2 = (((A0.v2 * l0 / h0) + (A1.v2 * l1 / h1) + (A2.v2 * l2 / h2)) / (l0 / h0 + l1 / h1 + l2 / h2));
-                break;
-            case AttributeType::VEC3:
-                A0.v3 = a.attributes[i].v3;
-                A1.v3 = b.attributes[i].v3;
-                A2.v3 = c.attributes[i].v3;
+            uint32_t sizeClass = 0;
+            for (float limit = 1.f; sizeClass + 1 < nofTriangleSizeClasses && setup.area >= limit; limit *= 4.f)
+                ++sizeClass;
+            ++statistics.triangleSizes[sizeClass];
+            ++statistics.rasterizedTriangles;
 
-                fragment.attributes[i].v3 = (((A0.v3 * l0 / h0) + (A1.v3 * l1 / h1) + (A2.v3 * l2 / h2)) / (l0 / h0 + l1 / h1 + l2 / h2));
-                break;
-            case AttributeType::VEC4:
-                A0.v4 = a.attributes[i].v4;
-                A1.v4 = b.attributes[i].v4;
-                A2.v4 = c.attributes[i].v4;
+            if (binned)
+                binTriangle(setup);
+            else
+                rasterize(context, setup);
+        }
+    }
+
+    if (binned)
+        rasterizeBins(pipeline);
+
+    accumulateStatistics(statistics, context.statistics);
+
+    //mapped pointers follow draw calls, other linear copies are resolved when they are requested
+    if (colorBufferMapped || depthBufferMapped)
+        resolveLinearFramebuffer(colorBufferMapped, depthBufferMapped);
+    colorBufferStale = !colorBufferMapped;
+    depthBufferStale = !depthBufferMapped;
+}
+
+/**
+ * @brief This function sets size of post-transform vertex cache.
+ * Vertices with the same gl_VertexID that are found in the cache are not shaded again.
+ *
+ * @param nofEntries number of vertices kept in FIFO cache, 0 disables the cache, fullVertexCache caches all vertices of a draw call
+ */
+void            GPU::setVertexCacheSize    (uint32_t  nofEntries){
+  vertexCacheSize = nofEntries;
+}
+
+/**
+ * @brief This function returns size of post-transform vertex cache.
+ *
+ * @return number of vertices kept in cache
+ */
+uint32_t        GPU::getVertexCacheSize    (){
+  return vertexCacheSize;
+}
+
+/**
+ * @brief This function selects which triangles are culled according to their facing.
+ *
+ * @param mode cull mode
+ */
+void            GPU::setCullMode           (CullMode  mode){
+  cullMode = mode;
+  boundPipelineDirty = true;
+}
+
+/**
+ * @brief This function selects winding of front-facing triangles.
+ *
+ * @param face winding of front-facing triangles in screen space
+ */
+void            GPU::setFrontFace          (FrontFace face){
+  frontFace = face;
+  boundPipelineDirty = true;
+}
+
+/**
+ * @brief This function enables lossless compression of depth tiles.
+ * Tile covered by a few triangles stores indices of their depth planes and a plane selector per pixel,
+ * other tiles fall back to uncompressed depth. Tiles become compressed when they are cleared.
+ *
+ * @param enabled true, if depth tiles are compressed
+ */
+void            GPU::setDepthCompression   (bool      enabled){
+  if (!enabled)
+      decompressDepthTiles();
+  depthCompression = enabled;
+}
+
+/**
+ * @brief This function returns whether depth tiles are compressed.
+ *
+ * @return true, if depth compression is enabled
+ */
+bool            GPU::getDepthCompression   (){
+  return depthCompression;
+}
+
+/**
+ * @brief This function sets number of threads used for rasterization.
+ * With more than one thread, triangles are binned into screen-space tiles and tiles are rasterized in parallel.
+ *
+ * @param nofThreads number of threads
+ */
+void            GPU::setNofThreads         (uint32_t  nofThreads){
+  if (nofThreads <= 1)
+      threadPool = nullptr;
+  else if (getNofThreads() != nofThreads)
+      threadPool = make_unique<ThreadPool>(nofThreads);
+}
+
+/**
+ * @brief This function returns number of threads used for rasterization.
+ *
+ * @return number of threads
+ */
+uint32_t        GPU::getNofThreads         (){
+  return threadPool ? threadPool->getNofWorkers() : 1;
+}
+
+//index fetch functions of vertex fetch plan
+static uint32_t fetchSequentialIndex(uint8_t const*, uint32_t invocation)
+{
+    return invocation;
+}
+
+template<typename INDEX>
+static uint32_t fetchIndex(uint8_t const*indices, uint32_t invocation)
+{
+    INDEX index;
+    memcpy(&index, indices + invocation * sizeof(INDEX), sizeof(INDEX));
+    return index;
+}
 
-                fragment.attributes[i].v4 = (((A0.v4 * l0 / h0) + (A1.v4 * l1 / h1) + (A2.v4 * l2 / h2)) / (l0 / h0 + l1 / h1 + l2 / h2));
+/**
+ * @brief This function builds vertex fetch plan of a vertex puller.
+ *
+ * @param fetchPlan output fetch plan
+ * @param vao vertex puller, plan of not existing vertex puller does not read any attributes
+ */
+void GPU::buildFetchPlan(FetchPlan &fetchPlan, VertexPullerID vao)
+{
+    fetchPlan.fetchIndex = fetchSequentialIndex;
+    fetchPlan.indices = nullptr;
+    fetchPlan.indexBuffer = emptyID;
+    fetchPlan.nofHeads = 0;
+
+    VertexPullerData const*puller = vertexPullers.find(vao);
+    if (!puller)
+        return;
+
+    vector<uint8_t> const*indexing = buffers.find(puller->indexing.bufferId);
+    if (indexing)
+    {
+        fetchPlan.indices = indexing->data();
+        fetchPlan.indexBuffer = puller->indexing.bufferId;
+        switch (puller->indexing.indexType)
+        {
+            case IndexType::UINT8:
+                fetchPlan.fetchIndex = fetchIndex<uint8_t>;
+                break;
+            case IndexType::UINT16:
+                fetchPlan.fetchIndex = fetchIndex<uint16_t>;
+                break;
+            case IndexType::UINT32:
+                fetchPlan.fetchIndex = fetchIndex<uint32_t>;
                 break;
         }
     }
-    fragment.gl_FragCoord.z = (((a.gl_Position.z * l0 / h0) + (b.gl_Position.z * l1 / h1) + (c.gl_Position.z * l2 / h2)) / (l0 / h0 + l1 / h1 + l2 / h2));
+
+    for (uint32_t i = 0; i < maxAttributes; ++i)
+    {
+        VertexHead const&head = puller->head[i];
+        vector<uint8_t> const*buffer = buffers.find(head.bufferId);
+        if (!head.enabled || head.attType == AttributeType::EMPTY || !buffer)
+            continue;
+
+        FetchHead &fetchHead = fetchPlan.heads[fetchPlan.nofHeads++];
+        fetchHead.data = buffer->data() + head.offset;
+        fetchHead.buffer = head.bufferId;
+        fetchHead.stride = head.stride;
+        fetchHead.size = static_cast<uint32_t>(head.attType) * sizeof(float);
+        fetchHead.attribute = i;
+    }
+}
+
+/**
+ * @brief This function fetches gl_VertexID of the next vertex of the draw call.
+ *
+ * @param plan vertex fetch plan
+ *
+ * @return index from index buffer or vertex number when indexing is not used
+ */
+uint32_t GPU::vertexIndex(FetchPlan const&plan)
+{
+    return plan.fetchIndex(plan.indices, vertPullInvCount++);
+}
+
+/**
+ * @brief This function assembles input vertex of vertex shader according to vertex fetch plan.
+ *
+ * @param plan vertex fetch plan
+ * @param vertexId gl_VertexID of the vertex
+ *
+ * @return input vertex
+ */
+InVertex GPU::vertexPuller(FetchPlan const&plan, uint32_t vertexId)
+{
+    InVertex inVertex;
+    inVertex.gl_VertexID = vertexId;
+
+    for (uint32_t i = 0; i < plan.nofHeads; ++i)
+    {
+        FetchHead const&head = plan.heads[i];
+        memcpy(&inVertex.attributes[head.attribute], head.data + head.stride * vertexId, head.size);
+    }
+
+    return inVertex;
+}
+
+/**
+ * @brief This function assembles batch of input vertices according to vertex fetch plan.
+ * Attributes are written directly in structure of arrays layout of batched vertex shader.
+ *
+ * @param plan vertex fetch plan
+ * @param vertexIds gl_VertexID of vertices
+ * @param count number of vertices, at most vertexShaderBatchSize
+ * @param batch output batch
+ */
+void GPU::vertexPuller(FetchPlan const&plan, uint32_t const*vertexIds, uint32_t count, InVertexBatch &batch)
+{
+    batch.count = count;
+    for (uint32_t lane = 0; lane < count; ++lane)
+        batch.gl_VertexID[lane] = vertexIds[lane];
+
+    for (uint32_t i = 0; i < plan.nofHeads; ++i)
+    {
+        FetchHead const&head = plan.heads[i];
+        float (*attribute)[vertexShaderBatchSize] = batch.attributes[head.attribute];
+        uint32_t const nofComponents = head.size / sizeof(float);
+        for (uint32_t lane = 0; lane < count; ++lane)
+        {
+            float components[4];
+            memcpy(components, head.data + head.stride * vertexIds[lane], head.size);
+            for (uint32_t k = 0; k < nofComponents; ++k)
+                attribute[k][lane] = components[k];
+        }
+    }
+}
+
+/**
+ * @brief This function pulls and shades vertices of a draw call.
+ * Vertices that hit post-transform vertex cache share one slot, slots are shaded in batches that can run in parallel.
+ *
+ * @param pipeline pipeline of the draw call
+ * @param nofVertices number of vertices of the draw call
+ */
+void GPU::processVertices(Pipeline const&pipeline, uint32_t nofVertices)
+{
+    vertexCacheIds.clear();
+    vertexCacheSlots.clear();
+    vertexCacheNext = 0;
+    fullVertexCacheSlots.clear();
+
+    vertexSlots.resize(nofVertices);
+    slotVertexIds.clear();
+    for (uint32_t i = 0; i < nofVertices; ++i)
+    {
+        uint32_t const vertexId = vertexIndex(pipeline.fetchPlan);
+
+        uint32_t slot;
+        if (vertexCacheLookup(vertexId, slot))
+            ++statistics.vertexCacheHits;
+        else
+        {
+            ++statistics.vertexCacheMisses;
+            slot = static_cast<uint32_t>(slotVertexIds.size());
+            slotVertexIds.push_back(vertexId);
+            vertexCacheInsert(vertexId, slot);
+        }
+        vertexSlots[i] = slot;
+    }
+
+    uint32_t const nofSlots = static_cast<uint32_t>(slotVertexIds.size());
+    uint32_t const stride = pipeline.vertexStride;
+    shadedVertices.resize(nofSlots * stride);
+
+    //only clip space position and varyings of the pipeline are kept from output vertex
+    auto const shadeScalar = [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t slot = begin; slot < end; ++slot)
+        {
+            //vertex shader starts with default constructed output vertex
+            OutVertex outVertex;
+            pipeline.vertexShader(outVertex, vertexPuller(pipeline.fetchPlan, slotVertexIds[slot]), *pipeline.uniforms);
+
+            float *packed = shadedVertices.data() + slot * stride;
+            memcpy(packed, &outVertex.gl_Position, sizeof(glm::vec4));
+            packed += 4;
+            for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+            {
+                Varying const&varying = pipeline.varyings[i];
+                memcpy(packed, &outVertex.attributes[varying.attribute], varying.nofComponents * sizeof(float));
+                packed += varying.nofComponents;
+            }
+        }
+    };
+
+    auto const shadeBatched = [&](uint32_t begin, uint32_t end)
+    {
+        InVertexBatch inBatch;
+        OutVertexBatch outBatch;
+        for (uint32_t first = begin; first < end; first += vertexShaderBatchSize)
+        {
+            uint32_t const count = glm::min(vertexShaderBatchSize, end - first);
+            vertexPuller(pipeline.fetchPlan, slotVertexIds.data() + first, count, inBatch);
+            pipeline.vertexShaderBatch(outBatch, inBatch, *pipeline.uniforms);
+
+            for (uint32_t lane = 0; lane < count; ++lane)
+            {
+                float *packed = shadedVertices.data() + (first + lane) * stride;
+                for (uint32_t k = 0; k < 4; ++k)
+                    *packed++ = outBatch.gl_Position[k][lane];
+                for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+                {
+                    Varying const&varying = pipeline.varyings[i];
+                    for (uint32_t k = 0; k < varying.nofComponents; ++k)
+                        *packed++ = outBatch.attributes[varying.attribute][k][lane];
+                }
+            }
+        }
+    };
+
+    auto const shadeBatch = [&](uint32_t batch, uint32_t)
+    {
+        uint32_t const begin = batch * vertexBatchSize;
+        uint32_t const end = glm::min(begin + vertexBatchSize, nofSlots);
+        if (pipeline.vertexShaderBatch)
+            shadeBatched(begin, end);
+        else
+            shadeScalar(begin, end);
+    };
+
+    uint32_t const nofBatches = (nofSlots + vertexBatchSize - 1) / vertexBatchSize;
+    if (threadPool)
+        threadPool->parallelFor(nofBatches, shadeBatch);
+    else
+        for (uint32_t batch = 0; batch < nofBatches; ++batch)
+            shadeBatch(batch, 0);
+}
+
+/**
+ * @brief This function looks up slot of shaded vertex in post-transform vertex cache.
+ *
+ * @param vertexId gl_VertexID of the vertex
+ * @param slot output slot of the shaded vertex
+ *
+ * @return true, if the vertex was found
+ */
+bool GPU::vertexCacheLookup(uint32_t vertexId, uint32_t &slot)
+{
+    if (vertexCacheSize == fullVertexCache)
+    {
+        auto const it = fullVertexCacheSlots.find(vertexId);
+        if (it == fullVertexCacheSlots.end())
+            return false;
+        slot = it->second;
+        return true;
+    }
+
+    for (uint32_t i = 0; i < vertexCacheIds.size(); ++i)
+    {
+        if (vertexCacheIds[i] == vertexId)
+        {
+            slot = vertexCacheSlots[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief This function inserts slot of shaded vertex into post-transform vertex cache.
+ * FIFO cache replaces the oldest vertex when it is full.
+ *
+ * @param vertexId gl_VertexID of the vertex
+ * @param slot slot of the shaded vertex
+ */
+void GPU::vertexCacheInsert(uint32_t vertexId, uint32_t slot)
+{
+    if (vertexCacheSize == 0)
+        return;
+
+    if (vertexCacheSize == fullVertexCache)
+    {
+        fullVertexCacheSlots[vertexId] = slot;
+        return;
+    }
+
+    if (vertexCacheIds.size() < vertexCacheSize)
+    {
+        vertexCacheIds.push_back(vertexId);
+        vertexCacheSlots.push_back(slot);
+        return;
+    }
+
+    vertexCacheIds[vertexCacheNext] = vertexId;
+    vertexCacheSlots[vertexCacheNext] = slot;
+    vertexCacheNext = (vertexCacheNext + 1) % vertexCacheSize;
+}
+
+/**
+ * @brief This function clips triangle in homogeneous clip space.
+ * Triangles that lie completely outside of a view volume plane are rejected, triangles inside of the near plane
+ * and the guard band are accepted without clipping. Only triangles that cross the near plane or leave
+ * the guard band are clipped, the rest of screen-space overflow is handled by bounding box clamping.
+ *
+ * @param polygon vertices of the triangle, they are replaced by vertices of the clipped convex polygon
+ * @param intersections storage of new vertices created by clipping, it has room for maxClipIntersections vertices
+ * @param pipeline pipeline with layout of vertices, clip space position followed by packed varyings
+ *
+ * @return number of vertices of the clipped polygon, 0 if the triangle was rejected
+ */
+uint32_t GPU::clipTriangle(float const*polygon[maxClippedVertices], float *intersections, Pipeline const&pipeline)
+{
+    //guard band in normalized device coordinates, screen-space coordinates inside of it stay far from snapping limits
+    float const guardBandPixels = static_cast<float>(1 << 14);
+    float const guardX = 1.f + 2.f * guardBandPixels / static_cast<float>(glm::max(getFramebufferWidth(), 1u));
+    float const guardY = 1.f + 2.f * guardBandPixels / static_cast<float>(glm::max(getFramebufferHeight(), 1u));
+
+    auto const position = [](float const*vertex)
+    {
+        return glm::vec4(vertex[0], vertex[1], vertex[2], vertex[3]);
+    };
+
+    //plane distances are non-negative inside, plane 0 is near plane, planes 1-4 are guard band, planes 5-8 are viewport
+    auto const distance = [&](glm::vec4 const&p, uint32_t plane)
+    {
+        switch (plane)
+        {
+            case 0: return p.z + p.w;
+            case 1: return guardX * p.w - p.x;
+            case 2: return guardX * p.w + p.x;
+            case 3: return guardY * p.w - p.y;
+            case 4: return guardY * p.w + p.y;
+            case 5: return p.w - p.x;
+            case 6: return p.w + p.x;
+            case 7: return p.w - p.y;
+            default: return p.w + p.y;
+        }
+    };
+    uint32_t const nofClipPlanes = 5;
+    uint32_t const nofPlanes = 9;
+
+    uint32_t outsideAll = (1u << nofPlanes) - 1;
+    uint32_t outsideAny = 0;
+    for (uint32_t v = 0; v < 3; ++v)
+    {
+        uint32_t outcode = 0;
+        for (uint32_t plane = 0; plane < nofPlanes; ++plane)
+            if (distance(position(polygon[v]), plane) < 0.f)
+                outcode |= 1u << plane;
+        outsideAll &= outcode;
+        outsideAny |= outcode;
+    }
+
+    if (outsideAll)
+    {
+        ++statistics.outsideTriangles;
+        return 0;
+    }
+
+    uint32_t const clipPlanes = outsideAny & ((1u << nofClipPlanes) - 1);
+    if (!clipPlanes)
+        return 3;
+
+    ++statistics.clippedTriangles;
+
+    //Sutherland-Hodgman clipping against planes that are crossed by the triangle
+    //vertices inside of a plane are passed by pointer, only intersections are written
+    float const*clipped[maxClippedVertices];
+    uint32_t nofVertices = 3;
+    for (uint32_t plane = 0; plane < nofClipPlanes && nofVertices > 0; ++plane)
+    {
+        if (!(clipPlanes & (1u << plane)))
+            continue;
+
+        uint32_t nofClipped = 0;
+        for (uint32_t v = 0; v < nofVertices; ++v)
+        {
+            float const*current = polygon[v];
+            float const*next = polygon[(v + 1) % nofVertices];
+            float const dc = distance(position(current), plane);
+            float const dn = distance(position(next), plane);
+
+            if (dc >= 0.f)
+                clipped[nofClipped++] = current;
+
+            if ((dc >= 0.f) != (dn >= 0.f))
+            {
+                float const t = dc / (dc - dn);
+                for (uint32_t k = 0; k < 4; ++k)
+                    intersections[k] = current[k] * (1.f - t) + next[k] * t;
+
+                //screen-space linear varyings use position of the intersection along the projected edge
+                float const projected = current[3] * (1.f - t) + next[3] * t;
+                float const s = projected != 0.f ? t * next[3] / projected : t;
+                uint32_t k = 4;
+                for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+                {
+                    Varying const&varying = pipeline.varyings[i];
+                    float const f = varying.interpolation == Interpolation::NOPERSPECTIVE ? s : t;
+                    for (uint32_t end = k + varying.nofComponents; k < end; ++k)
+                        intersections[k] = current[k] * (1.f - f) + next[k] * f;
+                }
+                clipped[nofClipped++] = intersections;
+                intersections += pipeline.vertexStride;
+            }
+        }
+
+        for (uint32_t v = 0; v < nofClipped; ++v)
+            polygon[v] = clipped[v];
+        nofVertices = nofClipped;
+    }
+
+    return nofVertices;
+}
+
+GPU::PrimitiveTriangle GPU::primitiveAssembly(float const*a, float const*b, float const*c, float const*provoking)
+{
+    PrimitiveTriangle triangle;
+    triangle.provoking = provoking;
+    float const*vertices[3] = {a, b, c};
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        triangle.position[i] = glm::vec4(vertices[i][0], vertices[i][1], vertices[i][2], vertices[i][3]);
+        triangle.varyings[i] = vertices[i] + 4;
+        perspectiveDivision(triangle.position[i]);
+        viewPortTransformation(triangle.position[i]);
+    }
+
+    return triangle;
+}
+
+void GPU::perspectiveDivision(glm::vec4 &position)
+{
+    position.x /= position.w;
+    position.y /= position.w;
+    position.z /= position.w;
+}
+
+void GPU::viewPortTransformation(glm::vec4 &position)
+{
+    position.x += 1.f;
+    position.y += 1.f;
+
+    position.x /= 2.f;
+    position.y /= 2.f;
+
+    position.x *= static_cast<float>(getFramebufferWidth());
+    position.y *= static_cast<float>(getFramebufferHeight());
+}
+
+//stamp lane i covers pixel (stampLaneX[i],stampLaneY[i]) relative to the stamp origin, lanes are ordered by 2x2 quads
+static int32_t const stampLaneX[stampSize] = {0, 1, 0, 1, 2, 3, 2, 3};
+static int32_t const stampLaneY[stampSize] = {0, 0, 1, 1, 0, 0, 1, 1};
+static float const stampLaneOffsetX[stampSize] = {0.f, 1.f, 0.f, 1.f, 2.f, 3.f, 2.f, 3.f};
+static float const stampLaneOffsetY[stampSize] = {0.f, 0.f, 1.f, 1.f, 0.f, 0.f, 1.f, 1.f};
+static uint32_t const fullStampMask = (1u << stampSize) - 1;
+
+/**
+ * @brief This function returns name of the coverage test implementation selected at build time.
+ *
+ * @return name of the implementation
+ */
+char const*GPU::getCoverageTestName(){
+#if defined(GPU_COVERAGE_AVX2)
+  return "AVX2";
+#elif defined(GPU_COVERAGE_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+/**
+ * @brief This function returns index of the lowest set bit.
+ *
+ * @param mask non-zero bit mask
+ *
+ * @return index of the lowest set bit
+ */
+static uint32_t lowestSetBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * @brief This function returns number of set bits.
+ *
+ * @param mask bit mask
+ *
+ * @return number of set bits
+ */
+static uint32_t bitCount(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    return static_cast<uint32_t>(__popcnt(mask));
+#else
+    return static_cast<uint32_t>(__builtin_popcount(mask));
+#endif
+}
+
+/**
+ * @brief This function converts colors of a shaded stamp to RGBA8 and stores them into consecutive pixels.
+ * Channel c is stored as 255 for c >= 1, 0 for c <= 0 and floor(c * 256) otherwise.
+ * Scaling by 256 is exact in float, so the result does not depend on precision of the conversion.
+ *
+ * @param colors first pixel of the stamp in color buffer, pixel i belongs to lane i
+ * @param outBatch shaded fragments
+ * @param mask lanes that are written
+ */
+static void storeStampColors(uint8_t *colors, OutFragmentBatch const&outBatch, uint32_t mask)
+{
+#if defined(GPU_COLOR_SSE2)
+    static_assert(fragmentBatchSize % 4 == 0, "stamp is converted by four lanes");
+    __m128 const scale = _mm_set1_ps(256.f);
+    __m128 const minValue = _mm_setzero_ps();
+    __m128 const maxValue = _mm_set1_ps(255.f);
+    __m128i const laneBits = _mm_set_epi32(8, 4, 2, 1);
+    for (uint32_t i = 0; i < fragmentBatchSize; i += 4)
+    {
+        //max returns its second operand for NaN, clamped values are non-negative, so truncation is floor
+        auto const channel = [&](uint32_t c)
+        {
+            __m128 const value = _mm_mul_ps(_mm_loadu_ps(outBatch.gl_FragColor[c] + i), scale);
+            return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(value, minValue), maxValue));
+        };
+        __m128i const packed = _mm_or_si128(_mm_or_si128(channel(0), _mm_slli_epi32(channel(1), 8)),
+                                            _mm_or_si128(_mm_slli_epi32(channel(2), 16), _mm_slli_epi32(channel(3), 24)));
+
+        __m128i *const pixels = reinterpret_cast<__m128i*>(colors + 4 * i);
+        __m128i const lanes = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(mask >> i)), laneBits), laneBits);
+        __m128i const old = _mm_loadu_si128(pixels);
+        _mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(lanes, packed), _mm_andnot_si128(lanes, old)));
+    }
+#else
+    for (uint32_t lanes = mask; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        uint8_t pixel[4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            float const value = outBatch.gl_FragColor[c][lane];
+            pixel[c] = value >= 1.f ? 255 : (value <= 0.f ? 0 : static_cast<uint8_t>(value * 256.f));
+        }
+        memcpy(colors + 4 * lane, pixel, sizeof(pixel));
+    }
+#endif
+}
+
+/**
+ * @brief This function tests which pixel centers of one stamp lie inside of a triangle.
+ *
+ * @param E biased edge function values at the stamp origin
+ * @param offsets edge function offsets of stamp lanes
+ *
+ * @return coverage mask, bit i is set if stamp lane i is covered
+ */
+static uint32_t stampCoverage(int64_t const E[3], int64_t const offsets[3][stampSize])
+{
+#if defined(GPU_COVERAGE_AVX2)
+    //a lane is outside if any of its edge functions is negative, i.e. has the sign bit set
+    __m256i outside0 = _mm256_setzero_si256();
+    __m256i outside1 = _mm256_setzero_si256();
+    for (int e = 0; e < 3; ++e)
+    {
+        __m256i const origin = _mm256_set1_epi64x(E[e]);
+        outside0 = _mm256_or_si256(outside0, _mm256_add_epi64(origin, _mm256_load_si256(reinterpret_cast<__m256i const*>(offsets[e] + 0))));
+        outside1 = _mm256_or_si256(outside1, _mm256_add_epi64(origin, _mm256_load_si256(reinterpret_cast<__m256i const*>(offsets[e] + 4))));
+    }
+    uint32_t const outside = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(outside0))) |
+                             static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(outside1))) << 4;
+    return ~outside & 0xffu;
+#elif defined(GPU_COVERAGE_SSE2)
+    __m128i outside[stampSize / 2];
+    for (uint32_t i = 0; i < stampSize / 2; ++i)
+        outside[i] = _mm_setzero_si128();
+    for (int e = 0; e < 3; ++e)
+    {
+        __m128i const origin = _mm_set1_epi64x(E[e]);
+        for (uint32_t i = 0; i < stampSize / 2; ++i)
+            outside[i] = _mm_or_si128(outside[i], _mm_add_epi64(origin, _mm_load_si128(reinterpret_cast<__m128i const*>(offsets[e] + 2 * i))));
+    }
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < stampSize / 2; ++i)
+        mask |= static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(outside[i]))) << (2 * i);
+    return ~mask & 0xffu;
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < stampSize; ++i)
+        if (((E[0] + offsets[0][i]) | (E[1] + offsets[1][i]) | (E[2] + offsets[2][i])) >= 0)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
+
+/**
+ * @brief This function returns mask of stamp lanes that lie inside of a pixel rectangle.
+ *
+ * @param stampX x coordinate of the stamp origin
+ * @param stampY y coordinate of the stamp origin
+ * @param rect inclusive pixel rectangle
+ *
+ * @return lane mask
+ */
+uint32_t GPU::stampRangeMask(int32_t stampX, int32_t stampY, PixelRect const&rect)
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < stampSize; ++i)
+    {
+        int32_t const x = stampX + stampLaneX[i];
+        int32_t const y = stampY + stampLaneY[i];
+        if (x >= rect.minX && x <= rect.maxX && y >= rect.minY && y <= rect.maxY)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+/**
+ * @brief This function culls triangle and computes its setup for rasterization.
+ * Culled triangles are counted by the reason of culling.
+ *
+ * @param setup output triangle setup
+ * @param pipeline pipeline of the draw call
+ * @param triangle triangle in screen space, its vertices are reordered to counter clock wise order
+ *
+ * @return true, if the triangle has to be rasterized
+ */
+bool GPU::triangleSetup(TriangleSetup &setup, Pipeline const&pipeline, PrimitiveTriangle &triangle)
+{
+    //snaps screen-space coordinate to fixed point with subPixelBits fractional bits
+    auto const snapToSubPixel = [](float v)
+    {
+        //keeps edge function products far away from int64 overflow
+        float const limit = static_cast<float>(1 << 15);
+        return static_cast<int64_t>(llround(static_cast<double>(glm::clamp(v, -limit, limit)) * static_cast<double>(subPixelScale)));
+    };
+
+    int64_t ax = snapToSubPixel(triangle.position[0].x), ay = snapToSubPixel(triangle.position[0].y);
+    int64_t bx = snapToSubPixel(triangle.position[1].x), by = snapToSubPixel(triangle.position[1].y);
+    int64_t cx = snapToSubPixel(triangle.position[2].x), cy = snapToSubPixel(triangle.position[2].y);
+
+    int64_t doubleArea = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    setup.area = static_cast<float>(llabs(doubleArea)) / static_cast<float>(2 * subPixelScale * subPixelScale);
+
+    if (doubleArea == 0)
+    {
+        ++statistics.zeroAreaCulled;
+        return false;
+    }
+
+    if (pipeline.cullMode != CullMode::NONE)
+    {
+        bool const frontFacing = (doubleArea > 0) == (pipeline.frontFace == FrontFace::CCW);
+        if (frontFacing == (pipeline.cullMode == CullMode::FRONT))
+        {
+            ++statistics.facingCulled;
+            return false;
+        }
+    }
+
+    //edge functions are positive inside of counter clock wise triangles
+    if (doubleArea < 0)
+    {
+        swap(triangle.position[1], triangle.position[2]);
+        swap(triangle.varyings[1], triangle.varyings[2]);
+        swap(bx, cx);
+        swap(by, cy);
+    }
+
+    //only pixels whose centers lie inside of the bounding box can be covered
+    int64_t const half = subPixelScale / 2;
+    int64_t const centerMinX = (glm::min(ax, glm::min(bx, cx)) - half + subPixelScale - 1) >> subPixelBits;
+    int64_t const centerMinY = (glm::min(ay, glm::min(by, cy)) - half + subPixelScale - 1) >> subPixelBits;
+    int64_t const centerMaxX = (glm::max(ax, glm::max(bx, cx)) - half) >> subPixelBits;
+    int64_t const centerMaxY = (glm::max(ay, glm::max(by, cy)) - half) >> subPixelBits;
+
+    if (centerMinX > centerMaxX || centerMinY > centerMaxY)
+    {
+        ++statistics.subPixelCulled;
+        return false;
+    }
+
+    int64_t const minX = glm::max(centerMinX, int64_t(0));
+    int64_t const minY = glm::max(centerMinY, int64_t(0));
+    int64_t const maxX = glm::min(centerMaxX, int64_t(getFramebufferWidth()) - 1);
+    int64_t const maxY = glm::min(centerMaxY, int64_t(getFramebufferHeight()) - 1);
+
+    if (minX > maxX || minY > maxY)
+    {
+        ++statistics.outsideTriangles;
+        return false;
+    }
+
+    setup.bounds.minX = static_cast<int32_t>(minX);
+    setup.bounds.minY = static_cast<int32_t>(minY);
+    setup.bounds.maxX = static_cast<int32_t>(maxX);
+    setup.bounds.maxY = static_cast<int32_t>(maxY);
+
+    //interpolated depth is clamped to the range of vertex depths
+    float const za = triangle.position[0].z, zb = triangle.position[1].z, zc = triangle.position[2].z;
+    setup.maxZ = glm::max(za, glm::max(zb, zc));
+    setup.minZ = glm::min(za, glm::min(zb, zc));
+
+    int64_t const px = minX * subPixelScale + half;
+    int64_t const py = minY * subPixelScale + half;
+
+    int64_t const vx[3] = {ax, bx, cx};
+    int64_t const vy[3] = {ay, by, cy};
+    for (int i = 0; i < 3; ++i)
+    {
+        int64_t const dx = vx[(i + 1) % 3] - vx[i];
+        int64_t const dy = vy[(i + 1) % 3] - vy[i];
+
+        //top-left fill rule: pixel centers on left or top edges are inside, on the other edges outside
+        bool const topLeft = dy < 0 || (dy == 0 && dx < 0);
+
+        setup.edge[i].value = dx * (py - vy[i]) - dy * (px - vx[i]) - (topLeft ? 0 : 1);
+        setup.edge[i].stepX = -dy * subPixelScale;
+        setup.edge[i].stepY = +dx * subPixelScale;
+
+        for (uint32_t lane = 0; lane < stampSize; ++lane)
+            setup.stampOffsets[i][lane] = stampLaneX[lane] * setup.edge[i].stepX + stampLaneY[lane] * setup.edge[i].stepY;
+
+        //edge function is linear, so its extremes inside of a block lie in block corners
+        int64_t const blockStepX = setup.edge[i].stepX * (rasterBlockSize - 1);
+        int64_t const blockStepY = setup.edge[i].stepY * (rasterBlockSize - 1);
+        setup.edge[i].blockMin = glm::min(blockStepX, int64_t(0)) + glm::min(blockStepY, int64_t(0));
+        setup.edge[i].blockMax = glm::max(blockStepX, int64_t(0)) + glm::max(blockStepY, int64_t(0));
+    }
+
+    //bounding box of a sliver can contain pixel centers that lie outside of the triangle, small boxes are tested exactly
+    if ((maxX - minX + 1) * (maxY - minY + 1) <= static_cast<int64_t>(stampSize))
+    {
+        bool covered = false;
+        for (int64_t y = 0; y <= maxY - minY; ++y)
+            for (int64_t x = 0; x <= maxX - minX; ++x)
+            {
+                int64_t outside = 0;
+                for (int i = 0; i < 3; ++i)
+                    outside |= setup.edge[i].value + x * setup.edge[i].stepX + y * setup.edge[i].stepY;
+                covered |= outside >= 0;
+            }
+        if (!covered)
+        {
+            ++statistics.subPixelCulled;
+            return false;
+        }
+    }
+
+    //plane equations are computed from snapped vertices, so covered pixel centers never extrapolate them
+    float const fx = static_cast<float>(bx - ax) / static_cast<float>(subPixelScale);
+    float const fy = static_cast<float>(by - ay) / static_cast<float>(subPixelScale);
+    float const gx = static_cast<float>(cx - ax) / static_cast<float>(subPixelScale);
+    float const gy = static_cast<float>(cy - ay) / static_cast<float>(subPixelScale);
+    float const invDet = 1.f / (fx * gy - gx * fy);
+    float const originX = static_cast<float>(px - ax) / static_cast<float>(subPixelScale);
+    float const originY = static_cast<float>(py - ay) / static_cast<float>(subPixelScale);
+
+    auto const planeEquation = [&](float va, float vb, float vc)
+    {
+        float const df = vb - va;
+        float const dg = vc - va;
+        PlaneEquation plane;
+        plane.stepX = (df * gy - dg * fy) * invDet;
+        plane.stepY = (fx * dg - gx * df) * invDet;
+        plane.value = va + plane.stepX * originX + plane.stepY * originY;
+        return plane;
+    };
+
+    setup.depth = planeEquation(za, zb, zc);
+
+    float const wa = 1.f / triangle.position[0].w;
+    float const wb = 1.f / triangle.position[1].w;
+    float const wc = 1.f / triangle.position[2].w;
+    setup.oneOverW = planeEquation(wa, wb, wc);
+
+    //varyings are packed, so each float gets one plane equation
+    float const*va = triangle.varyings[0];
+    float const*vb = triangle.varyings[1];
+    float const*vc = triangle.varyings[2];
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+    {
+        Varying const&varying = pipeline.varyings[i];
+        for (uint32_t end = k + varying.nofComponents; k < end; ++k)
+        {
+            switch (varying.interpolation)
+            {
+                case Interpolation::SMOOTH:
+                    setup.attributes[k] = planeEquation(va[k] * wa, vb[k] * wb, vc[k] * wc);
+                    break;
+                case Interpolation::NOPERSPECTIVE:
+                    setup.attributes[k] = planeEquation(va[k], vb[k], vc[k]);
+                    break;
+                case Interpolation::FLAT:
+                    setup.attributes[k] = {triangle.provoking[k], 0.f, 0.f};
+                    break;
+            }
+        }
+    }
+
+    return true;
+}
+
+void GPU::binTriangle(TriangleSetup const&setup)
+{
+    uint32_t const index = static_cast<uint32_t>(binnedTriangles.size());
+    binnedTriangles.push_back(setup);
+
+    for (int32_t y = setup.bounds.minY / static_cast<int32_t>(binTileSize); y <= setup.bounds.maxY / static_cast<int32_t>(binTileSize); ++y)
+        for (int32_t x = setup.bounds.minX / static_cast<int32_t>(binTileSize); x <= setup.bounds.maxX / static_cast<int32_t>(binTileSize); ++x)
+            bins[y * binsX + x].push_back(index);
+}
+
+void GPU::rasterizeBins(Pipeline const&pipeline)
+{
+    vector<uint32_t> usedBins;
+    for (uint32_t i = 0; i < bins.size(); ++i)
+        if (!bins[i].empty())
+            usedBins.push_back(i);
+
+    vector<RasterContext> contexts(threadPool->getNofWorkers());
+    for (auto &context : contexts)
+        context.pipeline = &pipeline;
+
+    //each tile is owned by exactly one worker, so depth and color writes do not need locks
+    threadPool->parallelFor(static_cast<uint32_t>(usedBins.size()), [&](uint32_t job, uint32_t worker)
+    {
+        uint32_t const bin = usedBins[job];
+        RasterContext &context = contexts[worker];
+        int32_t const tileX = static_cast<int32_t>((bin % binsX) * binTileSize);
+        int32_t const tileY = static_cast<int32_t>((bin / binsX) * binTileSize);
+        context.rect.minX = tileX;
+        context.rect.minY = tileY;
+        context.rect.maxX = glm::min(tileX + static_cast<int32_t>(binTileSize), static_cast<int32_t>(getFramebufferWidth())) - 1;
+        context.rect.maxY = glm::min(tileY + static_cast<int32_t>(binTileSize), static_cast<int32_t>(getFramebufferHeight())) - 1;
+
+        for (uint32_t index : bins[bin])
+            rasterize(context, binnedTriangles[index]);
+        bins[bin].clear();
+    });
+
+    for (auto const&context : contexts)
+        accumulateStatistics(statistics, context.statistics);
+    binnedTriangles.clear();
+}
+
+void GPU::rasterize(RasterContext &context, TriangleSetup const&setup)
+{
+    PixelRect const rect = {
+        glm::max(setup.bounds.minX, context.rect.minX), glm::max(setup.bounds.minY, context.rect.minY),
+        glm::min(setup.bounds.maxX, context.rect.maxX), glm::min(setup.bounds.maxY, context.rect.maxY)};
+    if (rect.minX > rect.maxX || rect.minY > rect.maxY)
+        return;
+
+    static_assert((rasterBlockSize & (rasterBlockSize - 1)) == 0, "raster block size has to be power of two");
+    static_assert(rasterBlockSize % stampWidth == 0 && rasterBlockSize % stampHeight == 0, "raster block has to consist of whole stamps");
+
+    //blocks are aligned to the block grid
+    int32_t const startX = rect.minX & ~static_cast<int32_t>(rasterBlockSize - 1);
+    int32_t const startY = rect.minY & ~static_cast<int32_t>(rasterBlockSize - 1);
+
+    //whole blocks can be skipped only if their fragments would be rejected by early depth test
+    bool const hiZTest = context.pipeline->earlyDepthTest && setup.maxZ <= 1.f;
+
+    int64_t row[3];
+    int64_t blockStepX[3];
+    int64_t blockStepY[3];
+    for (int e = 0; e < 3; ++e)
+    {
+        row[e] = setup.edge[e].value + (startX - setup.bounds.minX) * setup.edge[e].stepX + (startY - setup.bounds.minY) * setup.edge[e].stepY;
+        blockStepX[e] = setup.edge[e].stepX * rasterBlockSize;
+        blockStepY[e] = setup.edge[e].stepY * rasterBlockSize;
+    }
+
+    for (int32_t y = startY; y <= rect.maxY; y += rasterBlockSize)
+    {
+        int64_t E[3] = {row[0], row[1], row[2]};
+
+        for (int32_t x = startX; x <= rect.maxX; x += rasterBlockSize)
+        {
+            bool outside = false;
+            bool inside = true;
+            for (int e = 0; e < 3; ++e)
+            {
+                outside |= E[e] + setup.edge[e].blockMax < 0;
+                inside &= E[e] + setup.edge[e].blockMin >= 0;
+            }
+
+            if (outside)
+                ++context.statistics.rejectedBlocks;
+            else if (hiZTest && setup.minZ >= hiZBuffer[(y / rasterBlockSize) * hiZWidth + x / rasterBlockSize])
+                ++context.statistics.hiZRejectedBlocks;
+            else
+                rasterizeBlock(context, setup, rect, x, y, E, inside);
+
+            for (int e = 0; e < 3; ++e)
+                E[e] += blockStepX[e];
+        }
+        for (int e = 0; e < 3; ++e)
+            row[e] += blockStepY[e];
+    }
+
+}
+
+void GPU::rasterizeBlock(RasterContext &context, TriangleSetup const&setup, PixelRect const&rect, int32_t blockX, int32_t blockY, int64_t const blockE[3], bool covered)
+{
+    if (covered)
+        ++context.statistics.acceptedBlocks;
+    else
+        ++context.statistics.partialBlocks;
+
+    int32_t const blockEnd = static_cast<int32_t>(rasterBlockSize) - 1;
+    bool const border = blockX < rect.minX || blockY < rect.minY || blockX + blockEnd > rect.maxX || blockY + blockEnd > rect.maxY;
+
+    bool depthWritten = false;
+    int64_t row[3] = {blockE[0], blockE[1], blockE[2]};
+    for (int32_t y = blockY; y <= blockY + blockEnd; y += stampHeight)
+    {
+        int64_t E[3] = {row[0], row[1], row[2]};
+
+        for (int32_t x = blockX; x <= blockX + blockEnd; x += stampWidth)
+        {
+            uint32_t mask = fullStampMask;
+            if (border)
+                mask = stampRangeMask(x, y, rect);
+
+            if (mask && !covered)
+            {
+                context.statistics.testedPixels += stampSize;
+                mask &= stampCoverage(E, setup.stampOffsets);
+            }
+
+            if (mask)
+                depthWritten |= shadeStamp(context, setup, x, y, mask);
+
+            for (int e = 0; e < 3; ++e)
+                E[e] += setup.edge[e].stepX * stampWidth;
+        }
+        for (int e = 0; e < 3; ++e)
+            row[e] += setup.edge[e].stepY * stampHeight;
+    }
+
+    if (depthWritten)
+        updateHiZTile(blockX / rasterBlockSize, blockY / rasterBlockSize);
+}
+
+/**
+ * @brief This function recomputes maximal depth of one tile of hierarchical depth buffer.
+ *
+ * @param tileX x coordinate of the tile
+ * @param tileY y coordinate of the tile
+ */
+void GPU::updateHiZTile(uint32_t tileX, uint32_t tileY)
+{
+    uint32_t const endX = glm::min((tileX + 1) * rasterBlockSize, getFramebufferWidth());
+    uint32_t const endY = glm::min((tileY + 1) * rasterBlockSize, getFramebufferHeight());
+
+    float maxDepth = -numeric_limits<float>::infinity();
+    for (uint32_t x = tileX * rasterBlockSize; x < endX; ++x)
+        for (uint32_t y = tileY * rasterBlockSize; y < endY; ++y)
+        {
+            uint32_t const pixel = framebufferPixel(x, y);
+            maxDepth = glm::max(maxDepth, readDepth(pixel, x, y));
+        }
+
+    hiZBuffer[tileY * hiZWidth + tileX] = maxDepth;
+}
+
+/**
+ * @brief This function recomputes whole hierarchical depth buffer from depth buffer.
+ */
+void GPU::rebuildHiZ()
+{
+    if (hiZWidth == 0)
+        return;
+
+    uint32_t const hiZHeight = static_cast<uint32_t>(hiZBuffer.size()) / hiZWidth;
+    for (uint32_t tileY = 0; tileY < hiZHeight; ++tileY)
+        for (uint32_t tileX = 0; tileX < hiZWidth; ++tileX)
+            updateHiZTile(tileX, tileY);
+}
+
+/**
+ * @brief This function shades fragments of one stamp and performs per fragment operations.
+ * Fragments are shaded in one batch, scalar fragment shader is invoked for each fragment through adapter.
+ *
+ * @param context rasterization worker
+ * @param setup triangle setup
+ * @param stampX x coordinate of the stamp origin
+ * @param stampY y coordinate of the stamp origin
+ * @param mask lanes of the stamp that are covered by the triangle
+ *
+ * @return true, if some fragment wrote depth buffer
+ */
+bool GPU::shadeStamp(RasterContext &context, TriangleSetup const&setup, int32_t stampX, int32_t stampY, uint32_t mask)
+{
+    context.statistics.fragments += bitCount(mask);
+
+    float const dx = static_cast<float>(stampX - setup.bounds.minX);
+    float const dy = static_cast<float>(stampY - setup.bounds.minY);
+
+    InFragmentBatch &batch = context.batch;
+    for (uint32_t lane = 0; lane < fragmentBatchSize; ++lane)
+    {
+        float const laneX = dx + stampLaneOffsetX[lane];
+        float const laneY = dy + stampLaneOffsetY[lane];
+        batch.gl_FragCoord[0][lane] = static_cast<float>(stampX + stampLaneX[lane]) + 0.5f;
+        batch.gl_FragCoord[1][lane] = static_cast<float>(stampY + stampLaneY[lane]) + 0.5f;
+        batch.gl_FragCoord[2][lane] = glm::clamp(setup.depth.at(laneX, laneY), setup.minZ, setup.maxZ);
+        batch.gl_FragCoord[3][lane] = setup.oneOverW.at(laneX, laneY);
+    }
+
+    Pipeline const&pipeline = *context.pipeline;
+    //stamp lanes follow Morton order of framebuffer tile, pixels of the stamp are consecutive
+    static_assert(framebufferTileSize % stampWidth == 0 && framebufferTileSize % stampHeight == 0, "stamp has to lie inside one framebuffer tile");
+    uint32_t const stampPixel = framebufferPixel(static_cast<uint32_t>(stampX), static_cast<uint32_t>(stampY));
+    //tiles are owned by one binned rasterization tile, so only one worker materializes them
+    uint32_t const tile = stampPixel / framebufferTilePixels;
+    if (tileCleared[tile])
+        materializeTile(tile);
+
+    //depth test compares depth rounded to the format of depth buffer
+    float depths[fragmentBatchSize];
+    uint32_t testedLanes = 0;
+    for (uint32_t lanes = mask; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        uint32_t const pixel = stampPixel + lane;
+        depths[lane] = quantizeDepth(batch.gl_FragCoord[2][lane]);
+
+        //early depth test, occluded fragments do not invoke fragment shader
+        //triangles are not clipped by far plane, fragments behind it are shaded and resolved by late depth test
+        if (!pipeline.earlyDepthTest || batch.gl_FragCoord[2][lane] > 1.f)
+            continue;
+        ++testedLanes;
+        if (!(depths[lane] < readDepth(pixel, stampX + stampLaneX[lane], stampY + stampLaneY[lane])))
+        {
+            mask &= ~(1u << lane);
+            ++context.statistics.earlyDepthRejected;
+        }
+    }
+
+    context.statistics.depthBytes += depthTileBytes(tile, testedLanes);
+    if (!mask)
+        return false;
+
+    //helper lanes are interpolated only for batched fragment shader, scalar shader cannot compute derivatives
+    batch.mask = mask;
+    pipeline.interpolate(pipeline, batch, setup, dx, dy, pipeline.fragmentShaderBatch ? fullStampMask : mask);
+
+    OutFragmentBatch &outBatch = context.outBatch;
+    outBatch = OutFragmentBatch{};
+    context.statistics.shadedFragments += bitCount(mask);
+    if (pipeline.fragmentShaderBatch)
+        pipeline.fragmentShaderBatch(outBatch, batch, *pipeline.uniforms);
+    else
+        runScalarFragmentShader(pipeline, context.fragment, outBatch, batch);
+
+    uint32_t writtenLanes = 0;
+    for (uint32_t lanes = mask; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        uint32_t const pixel = stampPixel + lane;
+        uint32_t const x = stampX + stampLaneX[lane];
+        uint32_t const y = stampY + stampLaneY[lane];
+        float const z = depths[lane];
+        if (!(z < readDepth(pixel, x, y)))
+            continue;
+
+        writeDepth(pixel, x, y, z, setup.depthPlane);
+        writtenLanes |= 1u << lane;
+    }
+    context.statistics.depthBytes += depthTileBytes(tile, bitCount(mask)) + depthTileBytes(tile, bitCount(writtenLanes));
+
+    //colors of all written lanes are converted together and stored as packed pixels
+    if (writtenLanes)
+        storeStampColors(reinterpret_cast<uint8_t*>(ColorBuffer.data() + stampPixel), outBatch, writtenLanes);
+    return writtenLanes != 0;
+}
+
+/**
+ * @brief This function shades fragments of a batch by scalar fragment shader, one invocation per fragment in the mask.
+ *
+ * @param pipeline pipeline with scalar fragment shader
+ * @param fragment input fragment of scalar shader, only varyings of the pipeline are rewritten
+ * @param outBatch output fragments
+ * @param batch input fragments
+ */
+void GPU::runScalarFragmentShader(Pipeline const&pipeline, InFragment &fragment, OutFragmentBatch &outBatch, InFragmentBatch const&batch)
+{
+    for (uint32_t lanes = batch.mask; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        for (uint32_t c = 0; c < 4; ++c)
+            fragment.gl_FragCoord[c] = batch.gl_FragCoord[c][lane];
+        for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+        {
+            Varying const&varying = pipeline.varyings[i];
+            float *attribute = &fragment.attributes[varying.attribute].v1;
+            for (uint32_t k = 0; k < varying.nofComponents; ++k)
+                attribute[k] = batch.attributes[varying.attribute][k][lane];
+        }
+
+        OutFragment outFragment{};
+        pipeline.fragmentShader(outFragment, fragment, *pipeline.uniforms);
+        for (uint32_t c = 0; c < 4; ++c)
+            outBatch.gl_FragColor[c][lane] = outFragment.gl_FragColor[c];
+    }
+}
+
+/**
+ * @brief This function selects interpolation kernel for varying layout of a pipeline.
+ * Common layouts get kernels with compile-time numbers of components, other layouts use generic kernel.
+ *
+ * @param pipeline pipeline with built varying layout
+ *
+ * @return interpolation kernel
+ */
+GPU::Interpolator GPU::selectInterpolator(Pipeline const&pipeline)
+{
+    //specialized kernels interpolate all varyings with perspective correction
+    auto const signature = [&](std::initializer_list<uint32_t> components)
+    {
+        if (components.size() != pipeline.nofVaryings)
+            return false;
+        Varying const*varying = pipeline.varyings;
+        for (uint32_t nofComponents : components)
+        {
+            if (varying->nofComponents != nofComponents || varying->interpolation != Interpolation::SMOOTH)
+                return false;
+            ++varying;
+        }
+        return true;
+    };
+
+    if (signature({}))
+        return interpolateVaryings<>;
+    if (signature({1}))
+        return interpolateVaryings<1>;
+    if (signature({2}))
+        return interpolateVaryings<2>;
+    if (signature({3}))
+        return interpolateVaryings<3>;
+    if (signature({4}))
+        return interpolateVaryings<4>;
+    if (signature({3, 3}))
+        return interpolateVaryings<3, 3>;
+    if (signature({4, 4}))
+        return interpolateVaryings<4, 4>;
+    return interpolate;
+}
+
+/**
+ * @brief This function interpolates fragment attributes of a varying layout known at compile time.
+ * Loops over varyings and their components have constant trip counts, so they are unrolled without branches.
+ * When all lanes are interpolated, the innermost loop over lanes of the batch can be vectorized.
+ *
+ * @tparam COMPONENTS numbers of components of varyings in attribute order
+ * @param pipeline pipeline of the draw call
+ * @param batch output fragments, gl_FragCoord.w has to contain interpolated 1/w
+ * @param setup triangle setup
+ * @param dx x offset of the stamp origin from the first pixel of the bounding box
+ * @param dy y offset of the stamp origin from the first pixel of the bounding box
+ * @param lanes mask of interpolated lanes
+ */
+template<uint32_t... COMPONENTS>
+void GPU::interpolateVaryings(Pipeline const&pipeline, InFragmentBatch &batch, TriangleSetup const&setup, float dx, float dy, uint32_t lanes)
+{
+    uint32_t const nofVaryings = sizeof...(COMPONENTS);
+    if (nofVaryings == 0)
+        return;
+
+    //trailing zero keeps the array valid for empty signature
+    static constexpr uint32_t components[] = {COMPONENTS..., 0};
+
+    if (lanes == fullStampMask)
+    {
+        float x[fragmentBatchSize], y[fragmentBatchSize], w[fragmentBatchSize];
+        for (uint32_t lane = 0; lane < fragmentBatchSize; ++lane)
+        {
+            x[lane] = dx + stampLaneOffsetX[lane];
+            y[lane] = dy + stampLaneOffsetY[lane];
+            w[lane] = 1.f / batch.gl_FragCoord[3][lane];
+        }
+
+        PlaneEquation const*plane = setup.attributes;
+        for (uint32_t i = 0; i < nofVaryings; ++i)
+        {
+            float (*attribute)[fragmentBatchSize] = batch.attributes[pipeline.varyings[i].attribute];
+            for (uint32_t k = 0; k < components[i]; ++k)
+                for (uint32_t lane = 0; lane < fragmentBatchSize; ++lane)
+                    attribute[k][lane] = plane[k].at(x[lane], y[lane]) * w[lane];
+            plane += components[i];
+        }
+        return;
+    }
+
+    for (; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        float const x = dx + stampLaneOffsetX[lane];
+        float const y = dy + stampLaneOffsetY[lane];
+        float const w = 1.f / batch.gl_FragCoord[3][lane];
+
+        PlaneEquation const*plane = setup.attributes;
+        for (uint32_t i = 0; i < nofVaryings; ++i)
+        {
+            float (*attribute)[fragmentBatchSize] = batch.attributes[pipeline.varyings[i].attribute];
+            for (uint32_t k = 0; k < components[i]; ++k)
+                attribute[k][lane] = plane[k].at(x, y) * w;
+            plane += components[i];
+        }
+    }
+}
+
+/**
+ * @brief This function interpolates fragment attributes using plane equations of the triangle.
+ * It is generic kernel for any varying layout and interpolation qualifiers.
+ *
+ * @param pipeline pipeline of the draw call
+ * @param batch output fragments, gl_FragCoord.w has to contain interpolated 1/w
+ * @param setup triangle setup
+ * @param dx x offset of the stamp origin from the first pixel of the bounding box
+ * @param dy y offset of the stamp origin from the first pixel of the bounding box
+ * @param lanes mask of interpolated lanes
+ */
+void GPU::interpolate(Pipeline const&pipeline, InFragmentBatch &batch, TriangleSetup const&setup, float dx, float dy, uint32_t lanes)
+{
+    for (; lanes; lanes &= lanes - 1)
+    {
+        uint32_t const lane = lowestSetBit(lanes);
+        float const x = dx + stampLaneOffsetX[lane];
+        float const y = dy + stampLaneOffsetY[lane];
+        //reciprocal is computed only if some varying needs perspective correction
+        float const w = pipeline.perspective ? 1.f / batch.gl_FragCoord[3][lane] : 1.f;
+
+        PlaneEquation const*plane = setup.attributes;
+        for (uint32_t i = 0; i < pipeline.nofVaryings; ++i)
+        {
+            Varying const&varying = pipeline.varyings[i];
+            float (*attribute)[fragmentBatchSize] = batch.attributes[varying.attribute];
+            for (uint32_t k = 0; k < varying.nofComponents; ++k, ++plane)
+            {
+                switch (varying.interpolation)
+                {
+                    case Interpolation::SMOOTH:
+                        attribute[k][lane] = plane->at(x, y) * w;
+                        break;
+                    case Interpolation::NOPERSPECTIVE:
+                        attribute[k][lane] = plane->at(x, y);
+                        break;
+                    case Interpolation::FLAT:
+                        attribute[k][lane] = plane->value;
+                        break;
+                }
+            }
+        }
+    }
 }
 
 /// @}
@@ -7,12 +7,121 @@
 #pragma once
 
 #include <student/fwd.hpp>
-#include <map>
+#include <memory>
 #include <vector>
-#include <set>
+#include <unordered_map>
 
 using namespace std;
 
+class ThreadPool;
+
+/**
+ * @brief This class represents dense storage of objects that are addressed by generation-tagged ids.
+ * Objects are stored contiguously, slots of deleted objects are reused with increased generation,
+ * so stale ids of deleted objects stay invalid.
+ * Id consists of generation in upper 32 bits and slot index in lower 32 bits.
+ * Occupied slots have odd generation and free slots even generation, so generation 0 is never used.
+ *
+ * @tparam T type of stored objects
+ */
+template<typename T>
+class SlotMap{
+  public:
+    /**
+     * @brief This function inserts new object.
+     *
+     * @param object inserted object
+     *
+     * @return id of the object
+     */
+    ObjectID insert(T&&object){
+      uint32_t slot;
+      if (freeSlot != emptyID){
+        slot = freeSlot;
+        freeSlot = slots[slot].index;
+        ++slots[slot].generation;
+      }else{
+        slot = static_cast<uint32_t>(slots.size());
+        slots.push_back({1, 0});
+      }
+      slots[slot].index = static_cast<uint32_t>(objects.size());
+      objects.push_back(std::move(object));
+      objectSlots.push_back(slot);
+      return makeID(slot);
+    }
+
+    /**
+     * @brief This function removes object, the last object is moved to its place.
+     *
+     * @param id id of the object
+     */
+    void erase(ObjectID id){
+      if (!contains(id))
+        return;
+      uint32_t const slot  = static_cast<uint32_t>(id);
+      uint32_t const index = slots[slot].index;
+      objects[index] = std::move(objects.back());
+      objectSlots[index] = objectSlots.back();
+      slots[objectSlots[index]].index = index;
+      objects.pop_back();
+      objectSlots.pop_back();
+
+      ++slots[slot].generation;
+      slots[slot].index = freeSlot;
+      freeSlot = slot;
+    }
+
+    /**
+     * @brief This function tests if id refers to existing object.
+     *
+     * @param id id of the object
+     *
+     * @return true, if the object exists
+     */
+    bool contains(ObjectID id) const{
+      uint32_t const slot = static_cast<uint32_t>(id);
+      uint32_t const generation = static_cast<uint32_t>(id >> 32);
+      return slot < slots.size() && (generation & 1u) && slots[slot].generation == generation;
+    }
+
+    /**
+     * @brief This function returns object or nullptr if the id is not valid.
+     *
+     * @param id id of the object
+     *
+     * @return pointer to the object
+     */
+    T*find(ObjectID id){
+      return contains(id) ? &objects[slots[static_cast<uint32_t>(id)].index] : nullptr;
+    }
+
+    /**
+     * @brief This function returns object with valid id.
+     *
+     * @param id id of existing object
+     *
+     * @return the object
+     */
+    T&operator[](ObjectID id){
+      return objects[slots[static_cast<uint32_t>(id)].index];
+    }
+
+  private:
+    struct Slot{
+      uint32_t generation; ///< generation of the slot, it is increased when the object is inserted and deleted, it is odd if the slot is occupied
+      uint32_t index;      ///< index of the object, or next free slot if the slot is free
+    };
+
+    ObjectID makeID(uint32_t slot) const{
+      return (static_cast<ObjectID>(slots[slot].generation) << 32) | slot;
+    }
+
+    std::vector<T>       objects    ; ///< contiguous storage of objects
+    std::vector<uint32_t>objectSlots; ///< slot of each object
+    std::vector<Slot>    slots      ; ///< slots addressed by ids
+    uint32_t             freeSlot   = emptyID; ///< first free slot
+};
+
 /**
  * @brief This class represent software GPU
  */
@@ -44,7 +153,10 @@ class GPU{
     ProgramID createProgram          ();
     void      deleteProgram          (ProgramID prg);
     void      attachShaders          (ProgramID prg,VertexShader vs,FragmentShader fs);
-    void      setVS2FSType           (ProgramID prg,uint32_t attrib,AttributeType type);
+    void      attachVertexShaderBatch(ProgramID prg,VertexShaderBatch vs);
+    void      attachFragmentShaderBatch(ProgramID prg,FragmentShaderBatch fs);
+    void      setVS2FSType           (ProgramID prg,uint32_t attrib,AttributeType type,Interpolation interpolation = Interpolation::SMOOTH);
+    void      setEarlyDepthTest      (ProgramID prg,bool enable);
     void      useProgram             (ProgramID prg);
     bool      isProgram              (ProgramID prg);
     void      programUniform1f       (ProgramID prg,uint32_t uniformId,float     const&d);
@@ -53,18 +165,69 @@ class GPU{
     void      programUniform4f       (ProgramID prg,uint32_t uniformId,glm::vec4 const&d);
     void      programUniformMatrix4f (ProgramID prg,uint32_t uniformId,glm::mat4 const&d);
 
+    //pipeline object commands
+    PipelineID createPipeline        (ProgramID prg,VertexPullerID vao,CullMode mode = CullMode::NONE,FrontFace face = FrontFace::CCW);
+    void      deletePipeline         (PipelineID pipeline);
+    bool      isPipeline             (PipelineID pipeline);
+
     //framebuffer functions
-    void      createFramebuffer      (uint32_t width,uint32_t height);
+    void      createFramebuffer      (uint32_t width,uint32_t height,DepthFormat depthFormat = DepthFormat::D32F);
     void      deleteFramebuffer      ();
     void      resizeFramebuffer      (uint32_t width,uint32_t height);
+    void      resizeFramebuffer      (uint32_t width,uint32_t height,DepthFormat depthFormat);
     uint8_t*  getFramebufferColor    ();
     float*    getFramebufferDepth    ();
     uint32_t  getFramebufferWidth    ();
     uint32_t  getFramebufferHeight   ();
+    DepthFormat getFramebufferDepthFormat();
+    static uint32_t getDepthFormatSize(DepthFormat depthFormat);
 
     //execution commands
     void      clear                  (float r,float g,float b,float a);
     void      drawTriangles          (uint32_t  nofVertices);
+    void      drawTriangles          (PipelineID pipeline,uint32_t nofVertices);
+    void      setNofThreads          (uint32_t  nofThreads);
+    uint32_t  getNofThreads          ();
+    void      setVertexCacheSize     (uint32_t  nofEntries);
+    uint32_t  getVertexCacheSize     ();
+    void      setCullMode            (CullMode  mode);
+    void      setFrontFace           (FrontFace face);
+    void      setDepthCompression    (bool      enabled);
+    bool      getDepthCompression    ();
+
+    static uint32_t const fullVertexCache = 0xffffffff;///< vertex cache size that caches every vertex of a draw call
+
+    static uint32_t const nofTriangleSizeClasses = 8;///< number of classes in triangle size histogram
+
+    /**
+     * @brief This struct contains counters that are collected during drawing.
+     */
+    struct Statistics{
+      uint64_t vertexCacheHits     = 0;///< number of vertices reused from post-transform vertex cache
+      uint64_t vertexCacheMisses   = 0;///< number of vertex shader invocations
+      uint64_t outsideTriangles    = 0;///< number of triangles that lie completely outside of view volume or viewport
+      uint64_t clippedTriangles    = 0;///< number of triangles clipped by near plane or guard band
+      uint64_t facingCulled        = 0;///< number of triangles culled according to cull mode
+      uint64_t zeroAreaCulled      = 0;///< number of triangles with zero area
+      uint64_t subPixelCulled      = 0;///< number of triangles that do not cover any pixel center, triangles whose bounding box holds more pixels than a stamp are only tested by the bounding box
+      uint64_t rasterizedTriangles = 0;///< number of triangles that reached rasterization
+      uint64_t testedPixels        = 0;///< number of pixel centers tested against triangle edges
+      uint64_t rejectedBlocks      = 0;///< number of raster blocks that lie completely outside of triangles
+      uint64_t acceptedBlocks      = 0;///< number of raster blocks that lie completely inside of triangles
+      uint64_t partialBlocks       = 0;///< number of raster blocks that need per pixel coverage test
+      uint64_t hiZRejectedBlocks   = 0;///< number of raster blocks rejected by hierarchical depth test
+      uint64_t fragments           = 0;///< number of pixel centers that lie inside triangles
+      uint64_t earlyDepthRejected  = 0;///< number of fragments rejected by depth test before fragment shader
+      uint64_t shadedFragments     = 0;///< number of fragment shader invocations
+      uint64_t depthBytes          = 0;///< number of depth buffer bytes read and written by depth tests, compressed tiles count selectors and plane indices
+      /// number of triangles per screen-space area class, class i contains triangles with area in <4^(i-1),4^i) pixels
+      uint64_t triangleSizes[nofTriangleSizeClasses] = {};
+    };
+
+    //statistics
+    Statistics const&getStatistics   ();
+    void      resetStatistics        ();
+    static char const*getCoverageTestName();
 
     /// \addtogroup gpu_init 00. proměnné, inicializace / deinicializace grafické karty
     /// @{
@@ -72,23 +235,227 @@ class GPU{
     /// @}
 
 private:
+    /**
+     * @brief Triangle in screen space, varyings of its vertices stay in packed vertex storage.
+     */
     struct PrimitiveTriangle
     {
-        OutVertex a;
-        OutVertex b;
-        OutVertex c;
+        glm::vec4 position[3];   ///< screen-space positions of vertices
+        float const*varyings[3]; ///< packed varyings of vertices
+        float const*provoking;   ///< packed varyings of provoking vertex, they are used by flat varyings
+    };
+
+    static int32_t const subPixelBits = 8;///< number of fractional bits of snapped screen-space coordinates
+    static int64_t const subPixelScale = int64_t(1) << subPixelBits;
+
+    /**
+     * @brief Integer edge function of one triangle edge.
+     * The value is biased according to the top-left fill rule so that a pixel is covered if all values are non-negative.
+     */
+    struct EdgeFunction
+    {
+        int64_t value; ///< value at the center of the first pixel of the bounding box
+        int64_t stepX; ///< change of the value when moving one pixel to the right
+        int64_t stepY; ///< change of the value when moving one pixel up
+        int64_t blockMin; ///< offset of the minimal value inside of a raster block relative to the block origin
+        int64_t blockMax; ///< offset of the maximal value inside of a raster block relative to the block origin
+    };
+
+    /**
+     * @brief Inclusive rectangle of pixels.
+     */
+    struct PixelRect
+    {
+        int32_t minX, minY;
+        int32_t maxX, maxY;
+    };
+
+    /**
+     * @brief Screen-space plane equation of a value that is linear in screen space.
+     */
+    struct PlaneEquation
+    {
+        float value; ///< value at the center of the first pixel of the bounding box
+        float stepX; ///< change of the value when moving one pixel to the right
+        float stepY; ///< change of the value when moving one pixel up
+
+        float at(float dx, float dy) const { return value + dx * stepX + dy * stepY; }
+    };
+
+    struct TriangleSetup
+    {
+        EdgeFunction edge[3];
+        alignas(32) int64_t stampOffsets[3][stampSize]; ///< edge function offsets of stamp lanes relative to stamp origin
+
+        PixelRect bounds; ///< bounding box snapped to pixel centers and clamped to the framebuffer
+        float minZ; ///< nearest depth of the triangle
+        float maxZ; ///< farthest depth of the triangle
+        float area;
+
+        PlaneEquation depth;     ///< depth, it is linear in screen space
+        PlaneEquation oneOverW;  ///< 1/w for perspective correct interpolation
+        PlaneEquation attributes[maxAttributes * 4]; ///< attribute/w of components of active attributes, in attribute order
+        uint32_t depthPlane;     ///< index of depth plane in depthPlanes, it is set only if depth compression is enabled
+    };
+
+    /**
+     * @brief Depth of a triangle in the form that is stored by compressed depth tiles.
+     * It is evaluated exactly like fragment depth, so decompressed depth is bit exact.
+     */
+    struct DepthPlane
+    {
+        PlaneEquation depth; ///< depth plane of triangle setup
+        int32_t originX;     ///< x coordinate of the pixel where depth.value is defined
+        int32_t originY;     ///< y coordinate of the pixel where depth.value is defined
+        float minZ;          ///< nearest depth of the triangle
+        float maxZ;          ///< farthest depth of the triangle
+    };
+
+    static uint32_t const maxTilePlanes = 4;///< number of depth planes of compressed tile, each pixel selects one by two bits
+
+    /**
+     * @brief Compressed depth of one framebuffer tile.
+     */
+    struct DepthTile
+    {
+        uint32_t planes[maxTilePlanes]; ///< indices of depth planes in depthPlanes
+        uint32_t selectors;             ///< two bits per pixel in Morton order, slot of plane that holds depth of the pixel
+        uint32_t nofPlanes;             ///< number of used slots, 0 means that the tile is stored uncompressed in DepthBuffer
+    };
+
+    /**
+     * @brief Reading head of vertex fetch plan, it copies one attribute of a vertex.
+     */
+    struct FetchHead
+    {
+        uint8_t const*data; ///< first attribute in buffer (buffer data with applied offset)
+        BufferID buffer;    ///< buffer that contains the data
+        uint64_t stride;    ///< distance of attributes of neighbouring vertices in bytes
+        uint32_t size;      ///< size of attribute in bytes
+        uint32_t attribute; ///< index of vertex attribute
+    };
+
+    /**
+     * @brief Vertex fetch plan of a vertex puller.
+     * It contains only enabled heads with resolved buffer pointers, so fetching of vertices does not touch object tables.
+     */
+    struct FetchPlan
+    {
+        uint32_t (*fetchIndex)(uint8_t const*indices, uint32_t invocation); ///< index fetch function specialized for index type
+        uint8_t const*indices;
+        BufferID indexBuffer; ///< buffer with indices, emptyID without indexing
+        uint32_t nofHeads;
+        FetchHead heads[maxAttributes];
+    };
+
+    /**
+     * @brief Attribute that is interpolated from vertex shader to fragment shader.
+     */
+    struct Varying
+    {
+        uint32_t attribute;     ///< index of vertex and fragment attribute
+        uint32_t nofComponents; ///< number of floats of the attribute
+        Interpolation interpolation;
     };
 
-    InVertex vertexPuller();
-    PrimitiveTriangle primitiveAssembly();
-    OutVertex perspectiveDivision(OutVertex &vertex);
-    OutVertex viewPortTransformation(OutVertex &vertex);
-    void rasterize(PrimitiveTriangle &triangle);
-    void interpolate(InFragment &fragment, glm::vec2 &p, OutVertex &a, OutVertex &b, OutVertex &c);
+    struct Pipeline;
 
+    /// interpolation kernel, it writes varyings of the pipeline into attributes of all lanes of a fragment batch
+    using Interpolator = void (*)(Pipeline const&pipeline, InFragmentBatch &batch, TriangleSetup const&setup, float dx, float dy, uint32_t lanes);
 
-    map<BufferID, vector<uint8_t>> bufferMap;
-    BufferID bufferCount;
+    /**
+     * @brief Pipeline state object, it contains everything a draw call needs in one flat struct.
+     * Shader program and vertex puller are validated and resolved once, when the pipeline is built.
+     */
+    struct Pipeline
+    {
+        VertexShader vertexShader;
+        VertexShaderBatch vertexShaderBatch; ///< batched vertex shader, scalar vertex shader is used if it is nullptr
+        FragmentShader fragmentShader;
+        FragmentShaderBatch fragmentShaderBatch; ///< batched fragment shader, scalar fragment shader is called through adapter if it is nullptr
+        Uniforms const*uniforms; ///< uniforms of the program, resolved at the start of each draw call
+        uint32_t nofVaryings;
+        Varying varyings[maxAttributes]; ///< attributes declared by setVS2FSType, in attribute order
+        uint32_t vertexStride; ///< number of floats of a shaded vertex, clip space position followed by packed varyings
+        Interpolator interpolate; ///< kernel specialized for numbers of components of varyings
+        bool perspective; ///< some varying uses perspective correct interpolation
+        bool earlyDepthTest;
+        CullMode cullMode;
+        FrontFace frontFace;
+        FetchPlan fetchPlan;
+        ProgramID program;
+        uint64_t bufferGeneration; ///< value of bufferGeneration when buffers of the fetch plan were last validated
+    };
+
+    /**
+     * @brief State of one rasterization worker.
+     * Each worker writes only pixels inside of its rectangle, so workers with disjoint rectangles do not need locks.
+     */
+    struct RasterContext
+    {
+        Pipeline const* pipeline;
+        PixelRect rect;        ///< pixels that may be written by this worker
+        InFragmentBatch batch;      ///< fragments of the shaded stamp, only varyings of the pipeline are rewritten
+        OutFragmentBatch outBatch;  ///< shaded fragments of the stamp
+        InFragment fragment;        ///< fragment of scalar fragment shader adapter
+        Statistics statistics; ///< counters collected by this worker
+    };
+
+    static uint32_t const binTileSize = 64;///< width and height of screen-space tile used by binned rasterization
+    static uint32_t const framebufferTileSize = 4;///< width and height of framebuffer storage tile, 4x4 pixels of color or depth fill one 64 byte cache line
+    static uint32_t const framebufferTilePixels = framebufferTileSize * framebufferTileSize;///< number of pixels in framebuffer storage tile
+    static uint32_t const vertexBatchSize = 256;///< number of vertices shaded by one job of vertex processing
+
+    void buildFetchPlan(FetchPlan &fetchPlan, VertexPullerID vao);
+    bool validateFetchPlan(Pipeline &pipeline);
+    void buildPipeline(Pipeline &pipeline, ProgramID prg, VertexPullerID vao, CullMode mode, FrontFace face);
+    void draw(Pipeline &pipeline, uint32_t nofVertices);
+    uint32_t vertexIndex(FetchPlan const&plan);
+    static InVertex vertexPuller(FetchPlan const&plan, uint32_t vertexId);
+    static void vertexPuller(FetchPlan const&plan, uint32_t const*vertexIds, uint32_t count, InVertexBatch &batch);
+    void processVertices(Pipeline const&pipeline, uint32_t nofVertices);
+    bool vertexCacheLookup(uint32_t vertexId, uint32_t &slot);
+    void vertexCacheInsert(uint32_t vertexId, uint32_t slot);
+    static uint32_t const maxVertexFloats = 4 + maxAttributes * 4;///< clip space position and all components of all attributes
+    static uint32_t const maxClippedVertices = 8;///< triangle clipped by near plane and four guard-band planes has at most 8 vertices
+    static uint32_t const maxClipIntersections = 10;///< each of five clip planes adds at most two intersections
+
+    uint32_t clipTriangle(float const*polygon[maxClippedVertices], float *intersections, Pipeline const&pipeline);
+    PrimitiveTriangle primitiveAssembly(float const*a, float const*b, float const*c, float const*provoking);
+    void perspectiveDivision(glm::vec4 &position);
+    void viewPortTransformation(glm::vec4 &position);
+    bool triangleSetup(TriangleSetup &setup, Pipeline const&pipeline, PrimitiveTriangle &triangle);
+    void binTriangle(TriangleSetup const&setup);
+    void rasterizeBins(Pipeline const&pipeline);
+    void rasterize(RasterContext &context, TriangleSetup const&setup);
+    void rasterizeBlock(RasterContext &context, TriangleSetup const&setup, PixelRect const&rect, int32_t blockX, int32_t blockY, int64_t const blockE[3], bool covered);
+    static uint32_t stampRangeMask(int32_t stampX, int32_t stampY, PixelRect const&rect);
+    bool shadeStamp(RasterContext &context, TriangleSetup const&setup, int32_t stampX, int32_t stampY, uint32_t mask);
+    static void runScalarFragmentShader(Pipeline const&pipeline, InFragment &fragment, OutFragmentBatch &outBatch, InFragmentBatch const&batch);
+    uint32_t framebufferPixel(uint32_t x, uint32_t y) const;
+    void allocateFramebuffer(uint32_t width, uint32_t height, DepthFormat format);
+    float quantizeDepth(float z) const;
+    float loadDepth(uint32_t pixel) const;
+    void storeDepth(uint32_t pixel, float z);
+    float planeDepth(DepthPlane const&plane, uint32_t x, uint32_t y) const;
+    float readDepth(uint32_t pixel, uint32_t x, uint32_t y) const;
+    void writeDepth(uint32_t pixel, uint32_t x, uint32_t y, float z, uint32_t plane);
+    uint32_t depthTileBytes(uint32_t tile, uint32_t nofPixels) const;
+    void decompressTile(uint32_t tile);
+    void decompressDepthTiles();
+    void materializeTile(uint32_t tile);
+    void loadMappedFramebuffer();
+    void resolveLinearFramebuffer(bool color, bool depth);
+    void updateHiZTile(uint32_t tileX, uint32_t tileY);
+    void rebuildHiZ();
+    static Interpolator selectInterpolator(Pipeline const&pipeline);
+    static void interpolate(Pipeline const&pipeline, InFragmentBatch &batch, TriangleSetup const&setup, float dx, float dy, uint32_t lanes);
+    template<uint32_t... COMPONENTS>
+    static void interpolateVaryings(Pipeline const&pipeline, InFragmentBatch &batch, TriangleSetup const&setup, float dx, float dy, uint32_t lanes);
+
+
+    SlotMap<vector<uint8_t>> buffers;
+    uint64_t bufferGeneration = 0; ///< it is increased when a buffer is deleted
 
     //region Vertex Puller Data
     struct indexingData
@@ -126,12 +493,11 @@ private:
         VertexHead head[maxAttributes];
     };
 
-    map<VertexPullerID, VertexPullerData> vertexPullerMap;
+    SlotMap<VertexPullerData> vertexPullers;
 
     VertexPullerID activePuller;
 
     unsigned int vertPullInvCount;
-    VertexPullerID pullerCount;
     //endregion
 
     //region Shader program
@@ -141,15 +507,24 @@ private:
         = default;
 
         VertexShader vertexShader;
+        VertexShaderBatch vertexShaderBatch;
         FragmentShader fragmentShader;
+        FragmentShaderBatch fragmentShaderBatch;
         Uniforms uniforms;
         AttributeType attributeType[maxAttributes];
+        Interpolation interpolation[maxAttributes];
+        bool earlyDepthTest = true; ///< depth test is performed before fragment shader
         //uint32_t attribId;
     };
-    map<ProgramID, ProgramSettings> programMap;
+    SlotMap<ProgramSettings> programs;
 
     ProgramID activeProgram;
-    ProgramID programIdCount;
+    //endregion
+
+    //region Pipeline state objects
+    SlotMap<Pipeline> pipelines;
+    Pipeline boundPipeline; ///< pipeline of active program and bound vertex puller, it is built lazily by drawTriangles
+    bool boundPipelineDirty = true; ///< active program, bound vertex puller or their state have changed since the pipeline was built
     //endregion
 
     //region Frame buffer
@@ -161,17 +536,59 @@ private:
         uint8_t a;
     };
 
-    vector<RGBColor> ColorBuffer;
-    vector<float> DepthBuffer;
-    uint32_t frWidth, frHeight;
+    vector<RGBColor> ColorBuffer; ///< color buffer stored in framebuffer tiles, pixels are Morton ordered inside a tile
+    vector<uint8_t> DepthBuffer;  ///< depth buffer stored in framebuffer tiles in depthFormat, pixels are Morton ordered inside a tile
+    DepthFormat depthFormat = DepthFormat::D32F;
+    uint32_t depthTexelSize = sizeof(float); ///< bytes of one pixel of depth buffer
+    uint32_t frWidth = 0, frHeight = 0;
+    uint32_t frTilesX = 0; ///< number of framebuffer tiles in one row
+    vector<uint8_t> tileCleared; ///< framebuffer tiles that hold clear values, their pixels are written on first access
+    RGBColor clearColor = {0, 0, 0, 0}; ///< color of cleared tiles
+    float clearDepth = 1.f;             ///< depth of cleared tiles
+
+    bool depthCompression = false; ///< cleared tiles become compressed depth tiles
+    vector<DepthTile> depthTiles;   ///< depth compression state of each framebuffer tile
+    vector<DepthPlane> depthPlanes; ///< depth planes referenced by compressed tiles, the first one is the clear depth
+    static uint32_t const maxDepthPlanes = 1u << 20;///< plane table is reset by decompression of all tiles when it grows beyond this size
+
+    vector<RGBColor> linearColorBuffer; ///< row-major copy of color buffer handed out by getFramebufferColor
+    vector<float> linearDepthBuffer;    ///< row-major copy of depth buffer handed out by getFramebufferDepth
+    bool colorBufferMapped = false; ///< color buffer pointer was handed out since the last clear, its content can change outside of GPU
+    bool colorBufferStale = true;   ///< linear color buffer does not contain the framebuffer
+
+    vector<float> hiZBuffer; ///< maximal depth of each raster block sized tile of depth buffer
+    uint32_t hiZWidth = 0;
+    bool depthBufferMapped = false; ///< depth buffer pointer was handed out since the last clear, its content can change outside of GPU
+    bool depthBufferStale = true;   ///< linear depth buffer does not contain the framebuffer
     //endregion
 
-    //region Primitive assembly
-    vector<OutVertex> outVertexBuffer;
+    //region Vertex processing
+    vector<uint32_t> vertexSlots;      ///< slot of shaded vertex for each vertex of the draw call
+    vector<uint32_t> slotVertexIds;    ///< gl_VertexID of each slot
+    vector<float> shadedVertices;      ///< shaded vertex of each slot, it has vertexStride floats of the pipeline
     //endregion
-    //TODO
-    set<BufferID> unUsedBufferIds;
-    set<BufferID> usedBufferIds;
+
+    //region Culling
+    CullMode cullMode = CullMode::NONE;
+    FrontFace frontFace = FrontFace::CCW;
+    //endregion
+
+    //region Post-transform vertex cache
+    uint32_t vertexCacheSize = 0; ///< number of cached vertices, 0 disables the cache
+    vector<uint32_t> vertexCacheIds; ///< ids of vertices in FIFO cache
+    vector<uint32_t> vertexCacheSlots; ///< slots of vertices in FIFO cache
+    uint32_t vertexCacheNext = 0; ///< FIFO position that is replaced next
+    unordered_map<uint32_t, uint32_t> fullVertexCacheSlots;
+    //endregion
+
+    //region Binned rasterization
+    unique_ptr<ThreadPool> threadPool;
+    vector<TriangleSetup> binnedTriangles;
+    vector<vector<uint32_t>> bins; ///< indices of binned triangles per tile, in submission order
+    uint32_t binsX, binsY;
+    //endregion
+
+    Statistics statistics;
 };
 
 
@@ -28,7 +28,7 @@ int main(int argc,char*argv[]){
     }
 
     if(args.runPerformanceTests){
-      runPerformanceTest(args.perfTests);
+      runPerformanceTest(args.perfTests,args.nofThreads);
       return 0;
     }
 
@@ -47,6 +47,7 @@ int main(int argc,char*argv[]){
     app.registerMethod<CZFlagMethod>        ("czech flag"                                       );
     app.registerMethod<PhongMethod         >("phong bunny"                                      );
     app.setMethod(args.method);
+    app.setNofThreads(args.nofThreads);
     app.start();
 
   }catch(std::exception&e){
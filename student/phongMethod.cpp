@@ -66,6 +66,31 @@ void phong_VS(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniform
     outVertex.attributes[1] = inVertex.attributes[1];
 }
 
+/**
+ * @brief This function represents batched vertex shader of phong method.
+ * It computes the same outputs as phong_VS for all vertices of the batch.
+ *
+ * @param outVertices output vertices
+ * @param inVertices input vertices
+ * @param uniforms uniform variables
+ */
+void phong_VSBatch(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&uniforms){
+  auto const mat = uniforms.uniform[1].m4 * uniforms.uniform[0].m4;
+  auto const&position = inVertices.attributes[0];
+
+  //the same order of operations as matrix vector product of glm
+  for(uint32_t row=0;row<4;++row)
+    for(uint32_t lane=0;lane<vertexShaderBatchSize;++lane)
+      outVertices.gl_Position[row][lane] =
+        (mat[0][row]*position[0][lane] + mat[1][row]*position[1][lane]) +
+        (mat[2][row]*position[2][lane] + mat[3][row]);
+
+  for(uint32_t attribute=0;attribute<2;++attribute)
+    for(uint32_t component=0;component<4;++component)
+      for(uint32_t lane=0;lane<vertexShaderBatchSize;++lane)
+        outVertices.attributes[attribute][component][lane] = inVertices.attributes[attribute][component][lane];
+}
+
 /**
  * @brief This function represents fragment shader of phong method.
  *
@@ -248,6 +273,7 @@ PhongMethod::PhongMethod(){
     gpu.enableVertexPullerHead(vao, 1);
     prg = gpu.createProgram();
     gpu.attachShaders(prg, phong_VS, phong_FS);
+    gpu.attachVertexShaderBatch(prg, phong_VSBatch);
     gpu.setVS2FSType(prg, 0, AttributeType::VEC3);
     gpu.setVS2FSType(prg, 1, AttributeType::VEC3);
 }
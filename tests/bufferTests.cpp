@@ -63,6 +63,40 @@ SCENARIO("GPU buffer id tests"){
 
 }
 
+SCENARIO("GPU buffer ids of deleted buffers should stay invalid when their storage is reused"){
+  std::cerr << "00b - GPU buffer id reuse tests" << std::endl;
+  auto gpu = GPU();
+
+  auto const b0 = gpu.createBuffer(8);
+  auto const b1 = gpu.createBuffer(8);
+  gpu.deleteBuffer(b0);
+
+  //free slot is not valid in any later generation until a buffer is created in it
+  for(BufferID generation=1;generation<=2;++generation)
+    REQUIRE(gpu.isBuffer(b0 + (generation<<32)) == false);
+
+  std::vector<BufferID>deleted = {b0};
+  for(size_t i=0;i<1000;++i){
+    auto const b = gpu.createBuffer(8);
+    REQUIRE(gpu.isBuffer(b) == true);
+    for(auto const&x:deleted)
+      REQUIRE(b != x);
+    gpu.deleteBuffer(b);
+    if(deleted.size() < 10)
+      deleted.push_back(b);
+  }
+
+  for(auto const&x:deleted)
+    REQUIRE(gpu.isBuffer(x) == false);
+  REQUIRE(gpu.isBuffer(b1) == true);
+
+  uint8_t const data = 42;
+  uint8_t read = 0;
+  gpu.setBufferData(b1,3,1,&data);
+  gpu.getBufferData(b1,3,1,&read);
+  REQUIRE(read == data);
+}
+
 SCENARIO("GPU buffer data tests"){
   std::cerr << "01 - GPU buffer data tests" << std::endl;
   auto gpu = GPU();
@@ -162,3 +162,86 @@ SCENARIO("triangles with 2 vertices behind near plane should be clipped"){
 
 }
 
+
+SCENARIO("triangles should be culled according to cull mode and front face"){
+  std::cerr << "16b - culling - back-facing and front-facing triangles" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=100;
+  uint32_t h=100;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderDataInject,fragmentShaderDump);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  //counter clock wise triangle followed by clock wise triangle
+  vsData.clear();
+  vsData.push_back({{},glm::vec4(-1.f,-1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(+1.f,-1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(-1.f,+1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(-1.f,+1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(+1.f,+1.f,0.f,1.f)});
+  vsData.push_back({{},glm::vec4(+1.f,-1.f,0.f,1.f)});
+
+  auto const draw = [&](CullMode mode,FrontFace face){
+    gpu->setCullMode(mode);
+    gpu->setFrontFace(face);
+    gpu->clear(0,0,0,1);
+    gpu->resetStatistics();
+    fsData.clear();
+    gpu->drawTriangles(6);
+    return fsData;
+  };
+
+  auto const lowerLeft  = [](std::vector<InFragment>const&fragments){
+    return std::all_of(fragments.begin(),fragments.end(),[](InFragment const&f){return f.gl_FragCoord.x+f.gl_FragCoord.y < 100.f;});
+  };
+
+  REQUIRE(draw(CullMode::NONE,FrontFace::CCW).size() == w*h);
+  REQUIRE(gpu->getStatistics().facingCulled == 0);
+
+  auto const ccwFragments = draw(CullMode::BACK,FrontFace::CCW);
+  REQUIRE(lowerLeft(ccwFragments));
+  REQUIRE(gpu->getStatistics().facingCulled == 1);
+
+  REQUIRE(draw(CullMode::FRONT,FrontFace::CW).size() == ccwFragments.size());
+  REQUIRE(gpu->getStatistics().facingCulled == 1);
+
+  //the shared diagonal belongs to exactly one of the triangles
+  auto const cwFragments = draw(CullMode::BACK,FrontFace::CW);
+  REQUIRE(!lowerLeft(cwFragments));
+  REQUIRE(ccwFragments.size() + cwFragments.size() == w*h);
+
+  //triangles that cannot produce fragments, vertices are given in pixels
+  auto const pixel = [&](float x,float y){return glm::vec4(x/w*2.f-1.f,y/h*2.f-1.f,0.f,1.f);};
+  vsData.clear();
+  //zero area
+  vsData.push_back({{},pixel(30.f,30.f)});
+  vsData.push_back({{},pixel(40.f,40.f)});
+  vsData.push_back({{},pixel(50.f,50.f)});
+  //bounding box without pixel center
+  vsData.push_back({{},pixel(10.1f,10.1f)});
+  vsData.push_back({{},pixel(10.4f,10.1f)});
+  vsData.push_back({{},pixel(10.1f,10.4f)});
+  //sliver whose bounding box contains pixel center (20.5,20.5) that lies outside of the sliver
+  vsData.push_back({{},pixel(20.f,20.2f)});
+  vsData.push_back({{},pixel(21.f,21.2f)});
+  vsData.push_back({{},pixel(21.f,21.f)});
+  //outside of the viewport
+  vsData.push_back({{},pixel(120.f,10.f)});
+  vsData.push_back({{},pixel(130.f,10.f)});
+  vsData.push_back({{},pixel(120.f,20.f)});
+
+  gpu->setCullMode(CullMode::NONE);
+  gpu->resetStatistics();
+  fsData.clear();
+  gpu->drawTriangles(12);
+  REQUIRE(fsData.empty());
+  REQUIRE(gpu->getStatistics().zeroAreaCulled == 1);
+  REQUIRE(gpu->getStatistics().subPixelCulled == 2);
+  REQUIRE(gpu->getStatistics().outsideTriangles == 1);
+  REQUIRE(gpu->getStatistics().rasterizedTriangles == 0);
+
+  gpu = nullptr;
+}
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <limits>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -50,6 +51,112 @@ SCENARIO("fragment shader should be executed roughly pixelCount/2 when rasterizi
     REQUIRE(fragmentShaderInvocationCounter >= expectedCount - err);
 }
 
+std::vector<glm::vec4>quadVertices;
+void vertexShaderQuad(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  outVertex.gl_Position = quadVertices.at(inVertex.gl_VertexID);
+}
+
+//quad of two triangles from the bottom left corner of NDC to x = right, y = top at depth z
+void setQuadVertices(float z,float right = 1.f,float top = 1.f){
+  quadVertices.clear();
+  quadVertices.push_back(glm::vec4(-1.f ,-1.f,z,1.f));
+  quadVertices.push_back(glm::vec4(right,-1.f,z,1.f));
+  quadVertices.push_back(glm::vec4(-1.f ,top ,z,1.f));
+  quadVertices.push_back(glm::vec4(-1.f ,top ,z,1.f));
+  quadVertices.push_back(glm::vec4(right,-1.f,z,1.f));
+  quadVertices.push_back(glm::vec4(right,top ,z,1.f));
+}
+
+std::vector<uint32_t>fragmentCounts;
+uint32_t fragmentCountsWidth = 0;
+void fragmentShaderPixelCounter(OutFragment&,InFragment const&inFragment,Uniforms const&){
+  auto const x = static_cast<uint32_t>(inFragment.gl_FragCoord.x);
+  auto const y = static_cast<uint32_t>(inFragment.gl_FragCoord.y);
+  fragmentCounts.at(y*fragmentCountsWidth+x)++;
+}
+
+SCENARIO("rasterization should produce exactly one fragment per pixel for triangles that share an edge"){
+  std::cerr << "17b - rasterization of shared edges (top-left fill rule)" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w = 100;
+  uint32_t h = 100;
+  gpu->createFramebuffer(w,h);
+
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderPixelCounter);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  //the shared diagonal passes exactly through pixel centers
+  setQuadVertices(0.f);
+
+  fragmentCountsWidth = w;
+  fragmentCounts.assign(w*h,0);
+  gpu->drawTriangles(6);
+
+  gpu = nullptr;
+
+  REQUIRE(std::count(fragmentCounts.begin(),fragmentCounts.end(),1u) == w*h);
+}
+
+void fragmentShaderCoordColor(OutFragment&outFragment,InFragment const&inFragment,Uniforms const&){
+  outFragment.gl_FragColor = glm::vec4(inFragment.gl_FragCoord.x/100.f,inFragment.gl_FragCoord.y/100.f,0.f,1.f);
+}
+
+bool batchQuadsValid = true;
+size_t batchFragments = 0;
+void fragmentShaderBatchCoordColor(OutFragmentBatch&outFragments,InFragmentBatch const&inFragments,Uniforms const&){
+  for(uint32_t lane=0;lane<fragmentBatchSize;++lane){
+    //lanes of 2x2 quads are neighbouring pixels, helper lanes included
+    uint32_t const quad = lane & ~3u;
+    float const dx = inFragments.gl_FragCoord[0][lane] - inFragments.gl_FragCoord[0][quad];
+    float const dy = inFragments.gl_FragCoord[1][lane] - inFragments.gl_FragCoord[1][quad];
+    batchQuadsValid &= dx == static_cast<float>(lane & 1u) && dy == static_cast<float>((lane >> 1) & 1u);
+    if(inFragments.mask & (1u << lane))batchFragments++;
+
+    outFragments.gl_FragColor[0][lane] = inFragments.gl_FragCoord[0][lane]/100.f;
+    outFragments.gl_FragColor[1][lane] = inFragments.gl_FragCoord[1][lane]/100.f;
+    outFragments.gl_FragColor[2][lane] = 0.f;
+    outFragments.gl_FragColor[3][lane] = 1.f;
+  }
+}
+
+SCENARIO("batched fragment shader should produce the same image as scalar fragment shader"){
+  std::cerr << "17c - batched fragment shader" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w = 100;
+  uint32_t h = 100;
+  gpu->createFramebuffer(w,h);
+
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderCoordColor);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  quadVertices.clear();
+  quadVertices.push_back(glm::vec4(-.9f,-.8f,0.f,1.f));
+  quadVertices.push_back(glm::vec4(+.7f,-.3f,0.f,1.f));
+  quadVertices.push_back(glm::vec4(-.2f,+.9f,0.f,1.f));
+
+  gpu->clear(0,0,0,0);
+  gpu->drawTriangles(3);
+  auto const fragments = gpu->getStatistics().shadedFragments;
+  std::vector<uint8_t>scalarImage(gpu->getFramebufferColor(),gpu->getFramebufferColor()+w*h*4);
+
+  gpu->attachFragmentShaderBatch(prg,fragmentShaderBatchCoordColor);
+  batchQuadsValid = true;
+  batchFragments = 0;
+  gpu->clear(0,0,0,0);
+  gpu->drawTriangles(3);
+  std::vector<uint8_t>batchImage(gpu->getFramebufferColor(),gpu->getFramebufferColor()+w*h*4);
+
+  REQUIRE(batchQuadsValid);
+  REQUIRE(batchFragments == fragments);
+  REQUIRE(scalarImage == batchImage);
+}
+
 Uniforms fUnif;
 
 void fragmentShaderUnif(OutFragment&,InFragment const&,Uniforms const&u){
@@ -269,6 +376,102 @@ SCENARIO("rasterization should interpolate vertex attributes using barycentric c
 
 }
 
+void vertexShaderSparse(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  float const id = static_cast<float>(inVertex.gl_VertexID);
+  outVertex.gl_Position = triVertices.at(inVertex.gl_VertexID);
+  outVertex.attributes[0].v4 = glm::vec4(7.f);
+  outVertex.attributes[2].v1 = id;
+  outVertex.attributes[9].v2 = glm::vec2(2.f*id,-id);
+}
+
+std::vector<InFragment>sparseFragments;
+void fragmentShaderSparse(OutFragment&,InFragment const&inFragment,Uniforms const&){
+  if(whichSample(inFragment.gl_FragCoord) < samplingLocations.size())
+    sparseFragments.push_back(inFragment);
+}
+
+SCENARIO("rasterization should interpolate only attributes declared by setVS2FSType"){
+  std::cerr << "22b - sparse varying layout" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=100;
+  uint32_t h=100;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderSparse,fragmentShaderSparse);
+  gpu->setVS2FSType(prg,2,AttributeType::FLOAT);
+  gpu->setVS2FSType(prg,9,AttributeType::VEC2);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  glm::vec2 fragCoord = {30.f,20.f};
+  samplingLocations.clear();
+  samplingLocations.push_back(fragCoord);
+  sparseFragments.clear();
+  initTriVertices();
+  gpu->drawTriangles(3);
+  gpu = nullptr;
+
+  REQUIRE(sparseFragments.size() == 1);
+  float area = w*h/2.f;
+  float l2 = ((fragCoord[1]+.5f)*w/2.f) / area;
+  float l1 = ((fragCoord[0]+.5f)*h/2.f) / area;
+  float id = l1 + 2.f*l2;
+  InFragment const&fragment = sparseFragments.at(0);
+  REQUIRE(equalFloats(fragment.attributes[2].v1,id));
+  REQUIRE(equalFloats(fragment.attributes[9].v2[0],2.f*id));
+  REQUIRE(equalFloats(fragment.attributes[9].v2[1],-id));
+  //attributes that are not declared keep their default value
+  REQUIRE(fragment.attributes[0].v4 == glm::vec4(1.f));
+}
+
+void vertexShaderQualifiers(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&){
+  outVertex.gl_Position = triVertices.at(inVertex.gl_VertexID);
+  outVertex.attributes[0].v3 = glm::vec3(0.f);
+  outVertex.attributes[0].v3[inVertex.gl_VertexID] = 1.f;
+  outVertex.attributes[1].v1 = static_cast<float>(inVertex.gl_VertexID) + 5.f;
+}
+
+SCENARIO("rasterization should interpolate attributes according to their interpolation qualifiers"){
+  std::cerr << "22c - noperspective and flat interpolation" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=100;
+  uint32_t h=100;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQualifiers,fragmentShaderSparse);
+  gpu->setVS2FSType(prg,0,AttributeType::VEC3 ,Interpolation::NOPERSPECTIVE);
+  gpu->setVS2FSType(prg,1,AttributeType::FLOAT,Interpolation::FLAT         );
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  glm::vec2 fragCoord = {30.f,20.f};
+  samplingLocations.clear();
+  samplingLocations.push_back(fragCoord);
+  sparseFragments.clear();
+
+  float hc[3] = {1,2,.5};
+  triVertices.clear();
+  triVertices.push_back({-hc[0],-hc[0],0.f,hc[0]});
+  triVertices.push_back({+hc[1],-hc[1],0.f,hc[1]});
+  triVertices.push_back({-hc[2],+hc[2],0.f,hc[2]});
+
+  gpu->drawTriangles(3);
+  gpu = nullptr;
+
+  REQUIRE(sparseFragments.size() == 1);
+  float area = w*h/2.f;
+  float l2 = ((fragCoord[1]+.5f)*w/2.f) / area;
+  float l1 = ((fragCoord[0]+.5f)*h/2.f) / area;
+  float l0 = 1.f - l1 - l2;
+  InFragment const&fragment = sparseFragments.at(0);
+  REQUIRE(equalFloats(fragment.attributes[0].v3[0],l0));
+  REQUIRE(equalFloats(fragment.attributes[0].v3[1],l1));
+  REQUIRE(equalFloats(fragment.attributes[0].v3[2],l2));
+  REQUIRE(fragment.attributes[1].v1 == 5.f);
+}
+
 SCENARIO("rasterization should interpolate vertex attributes using barycentric coordinates with perspective correction and interpolate correct fragment depth"){
   std::cerr << "23 - perspective correct interpolation of vertex attributes to fragment attributes" << std::endl;
   auto gpu = std::make_shared<GPU>();
@@ -390,3 +593,263 @@ SCENARIO("per fragment operations should eliminate fragments that do not pass de
   REQUIRE(color[(10*w+10)*4+2]==0.f);
 
 }
+
+SCENARIO("early depth test should skip fragment shader for occluded fragments unless the program opts out"){
+  std::cerr << "24b - early depth test" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=100;
+  uint32_t h=100;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderPixelCounter);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  fragmentCountsWidth = w;
+  gpu->clear(0,0,0,1);
+  setQuadVertices(-.5f);
+  gpu->drawTriangles(6);
+
+  //occluded quad does not invoke fragment shader
+  setQuadVertices(+.5f);
+  fragmentCounts.assign(w*h,0);
+  gpu->drawTriangles(6);
+  REQUIRE(std::count(fragmentCounts.begin(),fragmentCounts.end(),0u) == w*h);
+
+  //program with disabled early depth test shades occluded fragments
+  gpu->setEarlyDepthTest(prg,false);
+  fragmentCounts.assign(w*h,0);
+  gpu->drawTriangles(6);
+  REQUIRE(std::count(fragmentCounts.begin(),fragmentCounts.end(),1u) == w*h);
+
+  auto fdepth = gpu->getFramebufferDepth();
+  REQUIRE(equalFloats(fdepth[50*w+50],-.5f));
+
+  gpu = nullptr;
+}
+
+SCENARIO("framebuffer pointers should expose row-major pixels of non-square framebuffer"){
+  std::cerr << "24c - tiled framebuffer, non-square resolve" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=37;
+  uint32_t h=22;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderWhite);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  //quad covers left half of the framebuffer at depth 0
+  setQuadVertices(0.f,0.f);
+
+  gpu->clear(0,0,0,0);
+  auto fcolor = gpu->getFramebufferColor();
+  auto fdepth = gpu->getFramebufferDepth();
+
+  //pixel written through the pointer occludes the quad
+  fdepth[3*w+5] = -1.f;
+  gpu->drawTriangles(6);
+
+  for(uint32_t y=0;y<h;++y)
+    for(uint32_t x=0;x<w;++x){
+      bool const covered = x*2+1 < w && !(x == 5 && y == 3);
+      REQUIRE(fcolor[(y*w+x)*4+0] == (covered?255:0));
+      REQUIRE(equalFloats(fdepth[y*w+x],x == 5 && y == 3 ? -1.f : (covered?0.f:1.f)));
+    }
+
+  gpu = nullptr;
+}
+
+SCENARIO("clear should be visible in all pixels even if tiles are written lazily"){
+  std::cerr << "24d - fast clear" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=30;
+  uint32_t h=18;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderWhite);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  //quad covers bottom half of the framebuffer
+  setQuadVertices(.5f,1.f,0.f);
+
+  gpu->clear(.5f,.25f,0.f,1.f);
+  auto fcolor = gpu->getFramebufferColor();
+  auto fdepth = gpu->getFramebufferDepth();
+
+  //mapped pointers follow draw calls
+  gpu->drawTriangles(6);
+  for(uint32_t y=0;y<h;++y)
+    for(uint32_t x=0;x<w;++x){
+      bool const covered = y < h/2;
+      REQUIRE(fcolor[(y*w+x)*4+0] == (covered?255:128));
+      REQUIRE(fcolor[(y*w+x)*4+1] == (covered?255: 64));
+      REQUIRE(fcolor[(y*w+x)*4+2] == (covered?255:  0));
+      REQUIRE(equalFloats(fdepth[y*w+x],covered?.5f:1.f));
+    }
+
+  //clear is resolved when the pointers are requested again
+  gpu->clear(0.f,0.f,1.f,0.f);
+  fcolor = gpu->getFramebufferColor();
+  fdepth = gpu->getFramebufferDepth();
+  for(uint32_t i=0;i<w*h;++i){
+    REQUIRE(fcolor[i*4+0] == 0);
+    REQUIRE(fcolor[i*4+2] == 255);
+    REQUIRE(equalFloats(fdepth[i],1.f));
+  }
+
+  gpu = nullptr;
+}
+
+void fragmentShaderBlack(OutFragment&outFragment,InFragment const&,Uniforms const&){
+  outFragment.gl_FragColor = glm::vec4(0.f,0.f,0.f,1.f);
+}
+
+SCENARIO("depth test should compare depth in precision of depth buffer format"){
+  std::cerr << "24e - depth formats" << std::endl;
+  uint32_t w=20;
+  uint32_t h=20;
+  float const z = .3f;
+  float const closer = z - 2e-6f;
+
+  for(auto const format:{DepthFormat::D32F,DepthFormat::D24,DepthFormat::D16}){
+    auto gpu = std::make_shared<GPU>();
+    gpu->createFramebuffer(w,h,format);
+    REQUIRE(gpu->getFramebufferDepthFormat() == format);
+    auto vao = gpu->createVertexPuller();
+    auto white = gpu->createProgram();
+    gpu->attachShaders(white,vertexShaderQuad,fragmentShaderWhite);
+    auto black = gpu->createProgram();
+    gpu->attachShaders(black,vertexShaderQuad,fragmentShaderBlack);
+    gpu->bindVertexPuller(vao);
+
+    gpu->useProgram(white);
+    setQuadVertices(z);
+    gpu->drawTriangles(6);
+
+    //slightly closer quad passes only if the difference is representable
+    gpu->useProgram(black);
+    setQuadVertices(closer);
+    gpu->drawTriangles(6);
+
+    auto fcolor = gpu->getFramebufferColor();
+    auto fdepth = gpu->getFramebufferDepth();
+    uint8_t const expected = format == DepthFormat::D16 ? 255 : 0;
+    float const precision = format == DepthFormat::D16 ? 2.f/65535.f : format == DepthFormat::D24 ? 2.f/16777215.f : 0.f;
+    for(uint32_t i=0;i<w*h;++i){
+      REQUIRE(fcolor[i*4+0] == expected);
+      REQUIRE(std::abs(fdepth[i] - z) <= z - closer + precision);
+    }
+  }
+}
+
+void fragmentShaderDepthColor(OutFragment&outFragment,InFragment const&inFragment,Uniforms const&){
+  outFragment.gl_FragColor = glm::vec4(inFragment.gl_FragCoord.z*.5f+.5f,inFragment.gl_FragCoord.x/100.f,0.f,1.f);
+}
+
+SCENARIO("compressed depth tiles should produce the same image and depth as uncompressed tiles"){
+  std::cerr << "24f - depth compression" << std::endl;
+  uint32_t w=61;
+  uint32_t h=47;
+
+  //overlapping slanted triangles, some tiles are covered by more triangles than a compressed tile can hold
+  std::vector<glm::vec4>triangles;
+  uint32_t seed = 7;
+  auto const random = [&](float a,float b){
+    seed = seed*1103515245u + 12345u;
+    return a + (b-a)*static_cast<float>((seed>>8)&0xffff)/65535.f;
+  };
+  for(uint32_t i=0;i<40;++i)
+    for(uint32_t k=0;k<3;++k)
+      triangles.push_back(glm::vec4(random(-1.2f,1.2f),random(-1.2f,1.2f),random(-.9f,.9f),1.f));
+
+  auto const render = [&](std::vector<glm::vec4>const&vertices,bool compression,DepthFormat format,std::vector<uint8_t>&color,std::vector<float>&depth){
+    auto gpu = std::make_shared<GPU>();
+    gpu->createFramebuffer(w,h,format);
+    gpu->setDepthCompression(compression);
+    REQUIRE(gpu->getDepthCompression() == compression);
+    auto vao = gpu->createVertexPuller();
+    auto prg = gpu->createProgram();
+    gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderDepthColor);
+    gpu->bindVertexPuller(vao);
+    gpu->useProgram(prg);
+
+    quadVertices = vertices;
+    gpu->clear(0,0,0,0);
+    gpu->drawTriangles(static_cast<uint32_t>(vertices.size()));
+    auto const depthBytes = gpu->getStatistics().depthBytes;
+
+    auto fcolor = gpu->getFramebufferColor();
+    auto fdepth = gpu->getFramebufferDepth();
+    color.assign(fcolor,fcolor+w*h*4);
+    depth.assign(fdepth,fdepth+w*h);
+    return depthBytes;
+  };
+
+  for(auto const format:{DepthFormat::D32F,DepthFormat::D16}){
+    std::vector<uint8_t>rawColor,compressedColor;
+    std::vector<float>rawDepth,compressedDepth;
+    render(triangles,false,format,rawColor,rawDepth);
+    render(triangles,true ,format,compressedColor,compressedDepth);
+    REQUIRE(compressedColor == rawColor);
+    REQUIRE(compressedDepth == rawDepth);
+  }
+
+  //two large slanted triangles, most tiles are covered by one plane
+  std::vector<glm::vec4>quad = {
+    glm::vec4(-1.f,-1.f,-.5f,1.f),glm::vec4(+1.f,-1.f,.2f,1.f),glm::vec4(-1.f,+1.f,.1f,1.f),
+    glm::vec4(-1.f,+1.f,.1f,1.f),glm::vec4(+1.f,-1.f,.2f,1.f),glm::vec4(+1.f,+1.f,.8f,1.f),
+  };
+  std::vector<uint8_t>rawColor,compressedColor;
+  std::vector<float>rawDepth,compressedDepth;
+  auto const rawBytes        = render(quad,false,DepthFormat::D32F,rawColor,rawDepth);
+  auto const compressedBytes = render(quad,true ,DepthFormat::D32F,compressedColor,compressedDepth);
+  REQUIRE(compressedColor == rawColor);
+  REQUIRE(compressedDepth == rawDepth);
+  REQUIRE(compressedBytes*2 < rawBytes);
+}
+
+std::vector<float>colorValues;
+uint32_t colorValuesWidth = 0;
+void fragmentShaderColorTable(OutFragment&outFragment,InFragment const&inFragment,Uniforms const&){
+  uint32_t const i = static_cast<uint32_t>(inFragment.gl_FragCoord.y)*colorValuesWidth + static_cast<uint32_t>(inFragment.gl_FragCoord.x);
+  for(uint32_t c=0;c<4;++c)
+    outFragment.gl_FragColor[c] = colorValues[(i*4+c)%colorValues.size()];
+}
+
+SCENARIO("fragment colors should be converted to 8 bit channels by flooring color multiplied by 256"){
+  std::cerr << "24g - packed color output conversion" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  uint32_t w=13;
+  uint32_t h=11;
+  gpu->createFramebuffer(w,h);
+  auto vao = gpu->createVertexPuller();
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderQuad,fragmentShaderColorTable);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  colorValuesWidth = w;
+  colorValues = {0.f,-0.f,-.5f,1.f,1.5f,.5f,1.f/256.f,255.f/256.f,.99999994f,.0039062f,1e-30f,-1e30f,1e30f,
+    std::numeric_limits<float>::infinity(),-std::numeric_limits<float>::infinity(),.123456f,.75f-1e-7f,.3333333f};
+  for(uint32_t i=0;i<101;++i)
+    colorValues.push_back(static_cast<float>(i)/100.f);
+
+  setQuadVertices(0.f);
+  gpu->clear(0,0,0,0);
+  gpu->drawTriangles(6);
+
+  auto fcolor = gpu->getFramebufferColor();
+  for(uint32_t i=0;i<w*h;++i)
+    for(uint32_t c=0;c<4;++c){
+      float const v = colorValues[(i*4+c)%colorValues.size()];
+      uint8_t const expected = v >= 1.0 ? 255 : (v <= 0.0 ? 0 : static_cast<uint8_t>(floor(v * 256.0)));
+      REQUIRE(fcolor[i*4+c] == expected);
+    }
+
+  gpu = nullptr;
+}
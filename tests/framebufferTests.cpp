@@ -29,5 +29,12 @@ SCENARIO("Framebuffer tests"){
   REQUIRE(gpu.getFramebufferColor() != nullptr);
   REQUIRE(gpu.getFramebufferDepth() != nullptr);
 
+  //resize without format keeps format of depth buffer
+  gpu.resizeFramebuffer(64,48,DepthFormat::D16);
+  REQUIRE(gpu.getFramebufferDepthFormat() == DepthFormat::D16);
+  gpu.resizeFramebuffer(100,120);
+  REQUIRE(gpu.getFramebufferWidth() == 100);
+  REQUIRE(gpu.getFramebufferDepthFormat() == DepthFormat::D16);
+
   gpu.deleteFramebuffer();
 }
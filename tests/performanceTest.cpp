@@ -5,6 +5,8 @@
 #include <vector>
 #include <memory>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <BasicCamera/OrbitCamera.h>
 #include <BasicCamera/PerspectiveCamera.h>
 #include <student/phongMethod.hpp>
@@ -13,7 +15,9 @@
 
 #define ___ std::cerr << __FILE__ << "/" << __LINE__ << std::endl
 
-void runPerformanceTest(size_t framesPerMeasurement) {
+void phong_VSBatch(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&uniforms);
+
+void runPerformanceTest(size_t framesPerMeasurement,uint32_t nofThreads) {
   uint32_t width = 500;
   uint32_t height = 500;
   auto method = std::make_shared<PhongMethod>();
@@ -34,14 +38,111 @@ void runPerformanceTest(size_t framesPerMeasurement) {
   auto const camera = glm::vec3(glm::inverse(view)*glm::vec4(0.f,0.f,0.f,1.f));
 
 
-  Timer<float>timer;
-  timer.reset();
-  for (size_t i   = 0; i < framesPerMeasurement; ++i){
-    method->onDraw(proj,view,light,camera);
+  auto const measure = [&](uint32_t threads){
+    method->gpu.setNofThreads(threads);
+    Timer<float>timer;
+    method->gpu.resetStatistics();
+    timer.reset();
+    for (size_t i   = 0; i < framesPerMeasurement; ++i){
+      method->onDraw(proj,view,light,camera);
+    }
+    return timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+  };
+
+  std::cout << "Coverage test: " << GPU::getCoverageTestName() << std::endl;
+
+  if (nofThreads > 1){
+    auto const singleThreaded = measure(1);
+    std::cout << "Seconds per frame (1 thread): " << std::scientific << std::setprecision(10)
+              << singleThreaded << std::endl;
+    auto const multiThreaded = measure(nofThreads);
+    std::cout << "Seconds per frame (" << nofThreads << " threads): " << multiThreaded << std::endl;
+    std::cout << "Speedup: " << std::defaultfloat << singleThreaded / multiThreaded << std::endl;
+  }else{
+    auto const time = measure(1);
+    std::cout << "Seconds per frame: " << std::scientific << std::setprecision(10)
+              << time << std::endl;
+  }
+
+  auto const&stats  = method->gpu.getStatistics();
+  auto const frames = static_cast<uint64_t>(framesPerMeasurement);
+  std::cout << std::defaultfloat;
+  std::cout << "Triangles per frame: " << stats.rasterizedTriangles / frames
+            << " (outside of view volume: " << stats.outsideTriangles / frames
+            << ", clipped: " << stats.clippedTriangles / frames << ")" << std::endl;
+  std::cout << "Culled triangles per frame: facing " << stats.facingCulled / frames
+            << ", zero area " << stats.zeroAreaCulled / frames
+            << ", sub-pixel " << stats.subPixelCulled / frames << std::endl;
+  std::cout << "Tested pixels per frame: " << stats.testedPixels / frames
+            << " (fragments: " << stats.fragments / frames << ")" << std::endl;
+  std::cout << "Fragment shader invocations per frame: " << stats.shadedFragments / frames
+            << " (early depth rejected: " << stats.earlyDepthRejected / frames << ")" << std::endl;
+  std::cout << "Raster blocks per frame: rejected " << stats.rejectedBlocks / frames
+            << ", accepted " << stats.acceptedBlocks / frames
+            << ", partial " << stats.partialBlocks / frames
+            << ", hierarchical depth rejected " << stats.hiZRejectedBlocks / frames << std::endl;
+  std::cout << "Triangle size histogram (area in pixels: triangles per frame):" << std::endl;
+  uint64_t limit = 1;
+  for (uint32_t i = 0; i < GPU::nofTriangleSizeClasses; ++i, limit *= 4){
+    if (i + 1 < GPU::nofTriangleSizeClasses)
+      std::cout << "  < " << std::setw(6) << limit;
+    else
+      std::cout << "  >=" << std::setw(6) << limit / 4;
+    std::cout << ": " << stats.triangleSizes[i] / frames << std::endl;
+  }
+
+  std::cout << "Post-transform vertex cache (vertex cache hits / misses per frame):" << std::endl;
+  for (auto const size : {0u, 16u, 32u, GPU::fullVertexCache}){
+    method->gpu.setVertexCacheSize(size);
+    auto const time = measure(nofThreads);
+    if (size == GPU::fullVertexCache)
+      std::cout << "  full";
+    else
+      std::cout << "  " << std::setw(4) << size;
+    std::cout << ": " << stats.vertexCacheHits / frames << " / " << stats.vertexCacheMisses / frames
+              << ", seconds per frame: " << std::scientific << time << std::defaultfloat << std::endl;
+  }
+  method->gpu.setVertexCacheSize(0);
+
+  method->gpu.setCullMode(CullMode::BACK);
+  auto const culledTime = measure(nofThreads);
+  method->gpu.setCullMode(CullMode::NONE);
+  std::cout << "Back-face culling: " << stats.facingCulled / frames << " culled triangles per frame"
+            << ", seconds per frame: " << std::scientific << culledTime << std::defaultfloat << std::endl;
+
+  std::cout << "Depth buffer formats (depth test traffic per frame):" << std::endl;
+  for (auto const format : {DepthFormat::D32F, DepthFormat::D24, DepthFormat::D16}){
+    method->gpu.resizeFramebuffer(width,height,format);
+    auto const time = measure(nofThreads);
+    char const*const names[] = {"D32F", "D24 ", "D16 "};
+    std::cout << "  " << names[static_cast<uint32_t>(format)] << ": " << GPU::getDepthFormatSize(format) << " bytes per pixel, "
+              << static_cast<float>(stats.depthBytes / frames) / (1024.f * 1024.f) << " MiB"
+              << ", seconds per frame: " << std::scientific << time << std::defaultfloat << std::endl;
   }
-  auto const time = timer.elapsedFromStart() / static_cast<float>(framesPerMeasurement);
+  method->gpu.resizeFramebuffer(width,height,DepthFormat::D32F);
+
+  method->gpu.setDepthCompression(true);
+  auto const compressedTime = measure(nofThreads);
+  method->gpu.setDepthCompression(false);
+  std::cout << "Depth compression: " << static_cast<float>(stats.depthBytes / frames) / (1024.f * 1024.f) << " MiB"
+            << " of depth test traffic per frame, seconds per frame: " << std::scientific << compressedTime << std::defaultfloat << std::endl;
 
-  std::cout << "Seconds per frame: " << std::scientific << std::setprecision(10)
-            << time << std::endl;
+  auto const behindCamera = glm::translate(view,glm::vec3(0.f,0.f,10.f));
+  auto const measureVertices = [&](VertexShaderBatch vs){
+    method->gpu.attachVertexShaderBatch(method->prg,vs);
+    Timer<float>timer;
+    method->gpu.resetStatistics();
+    timer.reset();
+    for (size_t i = 0; i < framesPerMeasurement; ++i)
+      method->onDraw(proj,behindCamera,light,camera);
+    return static_cast<float>(stats.vertexCacheMisses) / timer.elapsedFromStart();
+  };
+  method->gpu.resizeFramebuffer(1,1);
+  auto const scalarVertices  = measureVertices(nullptr);
+  auto const batchedVertices = measureVertices(phong_VSBatch);
+  method->gpu.resizeFramebuffer(width,height);
+  std::cout << "Vertex shader throughput (vertices per second): scalar " << std::scientific
+            << scalarVertices << ", batched " << batchedVertices << std::defaultfloat
+            << " (speedup: " << batchedVertices / scalarVertices << ")" << std::endl;
 
 }
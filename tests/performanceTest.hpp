@@ -2,5 +2,5 @@
 
 #include <iostream>
 
-void runPerformanceTest(size_t framesPerMeasurement = 100);
+void runPerformanceTest(size_t framesPerMeasurement = 100,uint32_t nofThreads = 1);
 
@@ -8,13 +8,17 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <BasicCamera/OrbitCamera.h>
+#include <BasicCamera/PerspectiveCamera.h>
 #include <student/gpu.hpp>
+#include <student/phongMethod.hpp>
 #include <tests/testCommon.hpp>
 #include <tests/renderPhongFrame.hpp>
 #include <SDL.h>
 
 
 void phong_VS(OutVertex&outVertex,InVertex const&inVertex,Uniforms const&uniforms);
+void phong_VSBatch(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&uniforms);
 void phong_FS(OutFragment&outFragment,InFragment const&inFragment,Uniforms const&uniforms);
 
 SCENARIO("phongMethod vertex shader should forward world space position and normal"){
@@ -66,6 +70,39 @@ SCENARIO("vertex shader should compute correct gl_Position according to transfor
   REQUIRE(equalFloats (outVertex.gl_Position[3] ,  1.f));
 }
 
+SCENARIO("batched vertex shader should compute the same vertices as vertex shader"){
+  std::cerr << "31b - phongMethod - batched vertex shader" << std::endl;
+  Uniforms u;
+  u.uniform[0].m4 = glm::lookAt(glm::vec3(1.f,2.f,3.f),glm::vec3(0.f),glm::vec3(0.f,1.f,0.f));
+  u.uniform[1].m4 = glm::perspective(1.f,1.3f,.1f,100.f);
+
+  InVertexBatch inVertices;
+  for(uint32_t lane=0;lane<vertexShaderBatchSize;++lane){
+    for(uint32_t c=0;c<3;++c){
+      inVertices.attributes[0][c][lane] = static_cast<float>(lane*3+c)*.37f-2.f;
+      inVertices.attributes[1][c][lane] = static_cast<float>(c == lane%3);
+    }
+  }
+
+  OutVertexBatch outVertices;
+  phong_VSBatch(outVertices,inVertices,u);
+
+  for(uint32_t lane=0;lane<vertexShaderBatchSize;++lane){
+    InVertex inVertex;
+    for(uint32_t a=0;a<2;++a)
+      for(uint32_t c=0;c<4;++c)
+        inVertex.attributes[a].v4[c] = inVertices.attributes[a][c][lane];
+    OutVertex outVertex;
+    phong_VS(outVertex,inVertex,u);
+
+    for(uint32_t c=0;c<4;++c){
+      REQUIRE(outVertices.gl_Position[c][lane] == outVertex.gl_Position[c]);
+      REQUIRE(outVertices.attributes[0][c][lane] == outVertex.attributes[0].v4[c]);
+      REQUIRE(outVertices.attributes[1][c][lane] == outVertex.attributes[1].v4[c]);
+    }
+  }
+}
+
 SCENARIO("fragment shader should compute correct color for vertical normals"){
   std::cerr << "32 - phongMethod - fragment shader should compute correct color for vertical normals" << std::endl;
   Uniforms u;
@@ -414,3 +451,53 @@ SCENARIO("phong method should render correct image"){
   }
 
 }
+
+SCENARIO("phong method should render the same image with more threads as with one thread"){
+  std::cerr << "41b - phongMethod - multithreaded rendering equals serial rendering" << std::endl;
+
+  //framebuffer size is not a multiple of bin size
+  uint32_t width = 333;
+  uint32_t height = 257;
+
+  auto orbitCamera = basicCamera::OrbitCamera();
+  auto perspectiveCamera = basicCamera::PerspectiveCamera();
+  orbitCamera.addDistance(1.f);
+  perspectiveCamera.setNear(0.1f);
+  perspectiveCamera.setAspect(static_cast<float>(width) / static_cast<float>(height));
+  auto const proj = perspectiveCamera.getProjection();
+  auto const view = orbitCamera      .getView      ();
+  auto const camera = glm::vec3(glm::inverse(view)*glm::vec4(0.f,0.f,0.f,1.f));
+  auto const light  = glm::vec3(10.f,10.f,10.f);
+
+  auto const render = [&](uint32_t threads,bool compression,uint32_t cacheSize,CullMode cullMode,std::vector<uint8_t>&color,std::vector<float>&depth){
+    auto phong = PhongMethod();
+    phong.gpu.createFramebuffer(width,height);
+    phong.gpu.setNofThreads(threads);
+    phong.gpu.setDepthCompression(compression);
+    phong.gpu.setVertexCacheSize(cacheSize);
+    phong.gpu.setCullMode(cullMode);
+    phong.onDraw(proj,view,light,camera);
+
+    auto fcolor = phong.gpu.getFramebufferColor();
+    auto fdepth = phong.gpu.getFramebufferDepth();
+    color.assign(fcolor,fcolor+width*height*4);
+    depth.assign(fdepth,fdepth+width*height);
+  };
+
+  for(auto const compression:{false,true})
+    for(auto const cacheSize:{0u,GPU::fullVertexCache})
+      for(auto const cullMode:{CullMode::NONE,CullMode::BACK}){
+        std::vector<uint8_t>serialColor;
+        std::vector<float>serialDepth;
+        render(1,compression,cacheSize,cullMode,serialColor,serialDepth);
+        REQUIRE(*std::min_element(serialDepth.begin(),serialDepth.end()) < 1.f);
+
+        for(uint32_t threads=2;threads<=4;++threads){
+          std::vector<uint8_t>color;
+          std::vector<float>depth;
+          render(threads,compression,cacheSize,cullMode,color,depth);
+          REQUIRE(color == serialColor);
+          REQUIRE(depth == serialDepth);
+        }
+      }
+}
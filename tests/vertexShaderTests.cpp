@@ -173,6 +173,50 @@ void vertexShaderUniforms(OutVertex&,InVertex const&,Uniforms const&u){
   unif = u;
 }
 
+SCENARIO("post-transform vertex cache should reuse shaded vertices with the same gl_VertexID"){
+  std::cerr << "09b - vertex shader, post-transform vertex cache" << std::endl;
+
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(100,100);
+
+  std::vector<uint32_t> indices = {0,1,2,2,1,3,0,2,3};
+  auto const indicesSize = indices.size() * sizeof(decltype(indices)::value_type);
+
+  auto ebo = gpu->createBuffer(indicesSize);
+  gpu->setBufferData(ebo,0,indicesSize,indices.data());
+
+  auto vao = gpu->createVertexPuller();
+  gpu->setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
+
+  auto prg = gpu->createProgram();
+
+  gpu->attachShaders(prg,vertexShaderID,fragmentShaderEmpty);
+
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  gpu->setVertexCacheSize(GPU::fullVertexCache);
+  gpu->resetStatistics();
+  gl_VertexIds = {};
+  gpu->drawTriangles(static_cast<uint32_t>(indices.size()));
+
+  REQUIRE(gl_VertexIds == std::vector<uint32_t>({0,1,2,3}));
+  REQUIRE(gpu->getStatistics().vertexCacheHits   == 5);
+  REQUIRE(gpu->getStatistics().vertexCacheMisses == 4);
+
+  //FIFO cache with two entries
+  gpu->setVertexCacheSize(2);
+  gpu->resetStatistics();
+  gl_VertexIds = {};
+  gpu->drawTriangles(static_cast<uint32_t>(indices.size()));
+
+  REQUIRE(gl_VertexIds == std::vector<uint32_t>({0,1,2,3,0,2,3}));
+  REQUIRE(gpu->getStatistics().vertexCacheHits   == 2);
+  REQUIRE(gpu->getStatistics().vertexCacheMisses == 7);
+
+  gpu = nullptr;
+}
+
 SCENARIO("vertex shader should recieve uniforms from active shader program"){
   std::cerr << "10 - vertex shader, uniforms" << std::endl;
   auto gpu = std::make_shared<GPU>();
@@ -245,6 +289,53 @@ SCENARIO("vertex shader should recieve uniforms from active shader program"){
   }
 }
 
+SCENARIO("pipeline state object should keep program and vertex puller state from its creation"){
+  std::cerr << "10b - vertex shader, pipeline state objects" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(100,100);
+
+  std::vector<uint32_t> indices = {3,1,2};
+  auto const indicesSize = indices.size() * sizeof(decltype(indices)::value_type);
+
+  auto ebo = gpu->createBuffer(indicesSize);
+  gpu->setBufferData(ebo,0,indicesSize,indices.data());
+
+  auto vao = gpu->createVertexPuller();
+  gpu->setVertexPullerIndexing(vao,IndexType::UINT32,ebo);
+
+  auto prg = gpu->createProgram();
+  REQUIRE(gpu->createPipeline(prg,vao) == emptyID);
+
+  gpu->attachShaders(prg,vertexShaderID,fragmentShaderEmpty);
+  auto pipeline = gpu->createPipeline(prg,vao);
+  REQUIRE(gpu->isPipeline(pipeline) == true);
+
+  //changes of the vertex puller are not visible in existing pipeline
+  gpu->setVertexPullerIndexing(vao,IndexType::UINT32,emptyID);
+  gl_VertexIds = {};
+  gpu->drawTriangles(pipeline,3);
+  REQUIRE(gl_VertexIds == indices);
+
+  //uniforms are read when the pipeline is drawn
+  auto prg2 = gpu->createProgram();
+  gpu->attachShaders(prg2,vertexShaderUniforms,fragmentShaderEmpty);
+  auto pipeline2 = gpu->createPipeline(prg2,emptyID);
+  auto value = glm::vec4(1.f,2.f,3.f,4.f);
+  gpu->programUniform4f(prg2,2,value);
+  gpu->drawTriangles(pipeline2,3);
+  REQUIRE(unif.uniform[2].v4 == value);
+
+  //pipeline that reads deleted buffer is not drawn
+  gpu->deleteBuffer(ebo);
+  gl_VertexIds = {};
+  gpu->drawTriangles(pipeline,3);
+  REQUIRE(gl_VertexIds.empty());
+
+  gpu->deletePipeline(pipeline);
+  REQUIRE(gpu->isPipeline(pipeline) == false);
+  REQUIRE(gpu->isPipeline(pipeline2) == true);
+}
+
 std::vector<InVertex>inVertices;
 void vertexShaderVert(OutVertex&,InVertex const&i,Uniforms const&){
   inVertices.push_back(i);
@@ -467,6 +558,52 @@ SCENARIO("vertex shader should receive correct attributes when using multiple bu
   REQUIRE(inVertices[2].attributes[3].v4 == glm::vec4(18.f,19.f,20.f,21.f));
 }
 
+std::vector<uint32_t>batchVertexIds;
+std::vector<glm::vec2>batchAttributes;
+void vertexShaderBatchDump(OutVertexBatch&outVertices,InVertexBatch const&inVertices,Uniforms const&){
+  REQUIRE(inVertices.count <= vertexShaderBatchSize);
+  for(uint32_t lane=0;lane<inVertices.count;++lane){
+    batchVertexIds.push_back(inVertices.gl_VertexID[lane]);
+    batchAttributes.push_back(glm::vec2(inVertices.attributes[2][0][lane],inVertices.attributes[2][1][lane]));
+    for(uint32_t c=0;c<4;++c)
+      outVertices.gl_Position[c][lane] = 0.f;
+  }
+}
+
+SCENARIO("batched vertex shader should receive attributes in structure of arrays layout"){
+  std::cerr << "15b - batched vertex shader, attributes, indexing" << std::endl;
+  auto gpu = std::make_shared<GPU>();
+  gpu->createFramebuffer(100,100);
+
+  std::vector<float> vert = {0.f,1.f,2.f,3.f,4.f,5.f,6.f,7.f,8.f,9.f,10.f,11.f,12.f,13.f};
+  std::vector<uint16_t> indices = {6,0,3,1,2,5,4,4,0,2,1,3,5,6,2};
+  auto vbo = gpu->createBuffer(vert.size()*sizeof(float));
+  gpu->setBufferData(vbo,0,vert.size()*sizeof(float),vert.data());
+  auto ebo = gpu->createBuffer(indices.size()*sizeof(uint16_t));
+  gpu->setBufferData(ebo,0,indices.size()*sizeof(uint16_t),indices.data());
+
+  auto vao = gpu->createVertexPuller();
+  gpu->setVertexPullerHead(vao,2,AttributeType::VEC2,sizeof(float)*2,0,vbo);
+  gpu->enableVertexPullerHead(vao,2);
+  gpu->setVertexPullerIndexing(vao,IndexType::UINT16,ebo);
+
+  auto prg = gpu->createProgram();
+  gpu->attachShaders(prg,vertexShaderID,fragmentShaderEmpty);
+  gpu->attachVertexShaderBatch(prg,vertexShaderBatchDump);
+  gpu->bindVertexPuller(vao);
+  gpu->useProgram(prg);
+
+  batchVertexIds.clear();
+  batchAttributes.clear();
+  gl_VertexIds.clear();
+  gpu->drawTriangles(static_cast<uint32_t>(indices.size()));
+
+  REQUIRE(gl_VertexIds.empty());
+  REQUIRE(batchVertexIds == std::vector<uint32_t>(indices.begin(),indices.end()));
+  for(size_t i=0;i<indices.size();++i)
+    REQUIRE(batchAttributes[i] == glm::vec2(vert[indices[i]*2],vert[indices[i]*2+1]));
+}
+
 SCENARIO("vertex shader should receive correct attributes when using offset and stride and indexing"){
   std::cerr << "16 - vertex shader, attributes, offset, stride, indexing" << std::endl;
   auto gpu = std::make_shared<GPU>();